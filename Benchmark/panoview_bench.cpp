@@ -0,0 +1,467 @@
+/*
+
+ MIT License
+
+ Copyright © 2021 Samuel Venable
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+*/
+
+
+/* microbenchmarks for the hot paths in panoview.cpp, which is compiled into
+this translation unit so its internals can be called directly; results go
+to stdout (or --output) as json, one record per benchmark, so throughput
+can be tracked from commit to commit
+
+usage: panoview_bench [--sizes 1,4,16,64] [--output results.json]
+sizes are in megapixels of a synthetic 4:1 panorama, 500 is supported
+but needs a few gigabytes of memory and a lot of patience to encode */
+
+#define PANOVIEW_BENCHMARK
+#include "../panoview.cpp"
+
+#include <fstream>
+
+#if !defined(PANOVIEW_COMMIT)
+#define PANOVIEW_COMMIT "unknown"
+#endif
+
+namespace {
+
+typedef struct {
+  string Name;
+  double Megapixels;
+  int Iterations;
+  double Median;
+  double Minimum;
+  double Bytes;
+} RESULT;
+
+vector<RESULT> Results;
+
+/* runs fn until both the iteration and time budgets are spent, median is
+reported because a single page fault or context switch skews the mean */
+template<typename Function>
+void Benchmark(string name, double megapixels, double bytes, int iterations, Function fn) {
+  vector<double> times; double budget = FrameTimer::Now() + 2000;
+  for (int i = 0; i < iterations || (FrameTimer::Now() < budget && i < iterations * 10); i++) {
+    double begin = FrameTimer::Now(); fn();
+    times.push_back(FrameTimer::Now() - begin);
+    if (i + 1 >= iterations && FrameTimer::Now() >= budget) break;
+  }
+  std::sort(times.begin(), times.end());
+  RESULT result = { name, megapixels, (int)times.size(), times[times.size() / 2], times[0], bytes };
+  Results.push_back(result);
+  std::cerr << name << " (" << megapixels << " MP): " << result.Median << " ms" << std::endl;
+}
+
+/* for timings gathered piecewise rather than by calling one function */
+void Measure(string name, double megapixels, double bytes, vector<double> times) {
+  std::sort(times.begin(), times.end());
+  RESULT result = { name, megapixels, (int)times.size(), times[times.size() / 2], times[0], bytes };
+  Results.push_back(result);
+  std::cerr << name << " (" << megapixels << " MP): " << result.Median << " ms" << std::endl;
+}
+
+/* smooth gradients plus a little noise, so deflate neither gives up nor
+collapses the image to nothing; fixed seed keeps runs comparable */
+vector<unsigned char> SyntheticPanorama(unsigned width, unsigned height) {
+  vector<unsigned char> pixels((size_t)width * height * 4);
+  unsigned state = 2463534242u;
+  for (unsigned y = 0; y < height; y++) {
+    for (unsigned x = 0; x < width; x++) {
+      state ^= state << 13; state ^= state >> 17; state ^= state << 5;
+      unsigned char *px = &pixels[((size_t)y * width + x) * 4];
+      px[0] = (unsigned char)((x * 255ull / width) + (state & 7));
+      px[1] = (unsigned char)((y * 255ull / height) + ((state >> 3) & 7));
+      px[2] = (unsigned char)(((x / 64 + y / 64) & 1) * 128 + ((state >> 6) & 15));
+      px[3] = 255;
+    }
+  }
+  return pixels;
+}
+
+void PanoramaSize(double megapixels, unsigned *width, unsigned *height) {
+  *height = (unsigned)std::sqrt(megapixels * 1000000 / 4);
+  *width = *height * 4;
+}
+
+string TempPath(string name) {
+  #if defined(_WIN32)
+  const char *dir = getenv("TEMP");
+  #else
+  const char *dir = getenv("TMPDIR");
+  #endif
+  return string((dir && *dir) ? dir : "/tmp") + "/panoview_bench_" + name;
+}
+
+#if !defined(_WIN32)
+double InflateMilliseconds = 0;
+unsigned TimedZlibDecompress(unsigned char **out, size_t *outsize, const unsigned char *in,
+  size_t insize, const LodePNGDecompressSettings *settings) {
+  double begin = FrameTimer::Now();
+  unsigned error = lodepng_zlib_decompress(out, outsize, in, insize, settings);
+  InflateMilliseconds += FrameTimer::Now() - begin;
+  return error;
+}
+
+#endif
+
+void BenchmarkLoadImage(double megapixels) {
+  unsigned width, height; PanoramaSize(megapixels, &width, &height);
+  vector<unsigned char> pixels = SyntheticPanorama(width, height);
+  string fname = TempPath(to_string((int)megapixels) + "mp.png");
+  if (SaveImage(fname.c_str(), pixels.data(), width, height)) return;
+  pixels.clear(); pixels.shrink_to_fit();
+  Benchmark("LoadImage", megapixels, (double)width * height * 4, 3, [&]() {
+    unsigned char *data = nullptr; unsigned w = 0, h = 0;
+    LoadImage(&data, &w, &h, fname.c_str());
+    delete[] data;
+  });
+  // the display independent part of main() up to glutShowWindow(), which
+  // should cost no more than LoadImage above now that there is no warm-up
+  Benchmark("Startup", megapixels, (double)width * height * 4, 3, [&]() {
+    unsigned char *data = nullptr; unsigned w = 0, h = 0;
+    LoadImage(&data, &w, &h, fname.c_str());
+    TexWidth = w; TexHeight = h; AspectRatio = TexWidth / TexHeight;
+    InitialViewFromSettings(90, 10);
+    BuildPanoramaMesh(AspectRatio, &PanoramaMesh);
+    delete[] data;
+  });
+  // a second viewer of the same file, while the first keeps it published
+  TextureCache::IMAGE first, second;
+  if (TextureCache::Acquire(fname.c_str(), DecodeForCache, &first)) {
+    Benchmark("TextureCache::Acquire", megapixels, (double)width * height * 4, 3, [&]() {
+      TextureCache::Acquire(fname.c_str(), DecodeForCache, &second);
+      TextureCache::Release(&second);
+    });
+    TextureCache::Release(&first);
+  }
+  remove(fname.c_str());
+}
+
+#if !defined(_WIN32)
+/* libpng on Windows doesn't expose a zlib hook, so per filter inflate and
+unfilter timings are only available through lodepng */
+void BenchmarkFilters(double megapixels) {
+  unsigned width, height; PanoramaSize(megapixels, &width, &height);
+  vector<unsigned char> pixels = SyntheticPanorama(width, height);
+  for (int filter = LFS_ZERO; filter <= LFS_FOUR; filter++) {
+    LodePNGState state; lodepng_state_init(&state);
+    state.encoder.filter_strategy = (LodePNGFilterStrategy)filter;
+    unsigned char *png = nullptr; size_t pngsize = 0;
+    lodepng_encode(&png, &pngsize, pixels.data(), width, height, &state);
+    lodepng_state_cleanup(&state);
+    if (!png) continue;
+    vector<double> inflate, unfilter;
+    for (int i = 0; i < 3; i++) {
+      LodePNGState decoder; lodepng_state_init(&decoder);
+      decoder.decoder.zlibsettings.custom_zlib = TimedZlibDecompress;
+      unsigned char *out = nullptr; unsigned w = 0, h = 0;
+      InflateMilliseconds = 0; double begin = FrameTimer::Now();
+      lodepng_decode(&out, &w, &h, &decoder, png, pngsize);
+      double total = FrameTimer::Now() - begin;
+      inflate.push_back(InflateMilliseconds);
+      unfilter.push_back(total - InflateMilliseconds);
+      lodepng_state_cleanup(&decoder); free(out);
+    }
+    free(png);
+    Measure("inflate/filter" + to_string(filter), megapixels, (double)pngsize, inflate);
+    Measure("unfilter/filter" + to_string(filter), megapixels, (double)width * height * 4, unfilter);
+  }
+}
+
+#endif
+
+void BenchmarkSoftRender(double megapixels) {
+  unsigned width, height; PanoramaSize(megapixels, &width, &height);
+  vector<unsigned char> pixels = SyntheticPanorama(width, height);
+  SoftRender::TEXTURE texture = { pixels.data(), width, height };
+  SoftRender::CAMERA camera; vector<unsigned char> out(640 * 480 * 4);
+  SoftRender::CameraFromAngles(45, 5, 60, 1, &camera);
+  Benchmark("SoftRender::RenderPanorama/640x480", megapixels, 640 * 480 * 4, 20, [&]() {
+    SoftRender::RenderPanorama(&texture, &camera, out.data(), 640, 480, SoftRender::FILTER_BILINEAR, 0);
+  });
+}
+
+void BenchmarkMesh() {
+  MESH mesh;
+  Benchmark("BuildPanoramaMesh", 0, 0, 10000, [&]() {
+    BuildPanoramaMesh(4, &mesh);
+  });
+}
+
+void BenchmarkTexelUnderCursor() {
+  TexWidth = 8000; TexHeight = 2000; AspectRatio = 4;
+  volatile double sink = 0;
+  // GetTexelUnderCursor() minus the window size query, which needs a display
+  Benchmark("TexelFromViewport/1000", 0, 0, 1000, [&]() {
+    for (int i = 0; i < 1000; i++) {
+      double x, y; xangle = i % 360; yangle = (i % 11) - 5;
+      TexelFromViewport(319.5, 239.5, 640, 480, &x, &y); sink += x + y;
+    }
+  });
+}
+
+void BenchmarkPicking() {
+  // 10000 small hotspots scattered over an 8000 x 2000 panorama, a fifth polygons
+  vector<Picking::HOTSPOT> hotspots; unsigned state = 2463534242u;
+  for (int i = 0; i < 10000; i++) {
+    state ^= state << 13; state ^= state >> 17; state ^= state << 5;
+    Picking::HOTSPOT hotspot; hotspot.Name = to_string(i);
+    hotspot.Left = state % 8000; hotspot.Top = (state >> 13) % 2000;
+    hotspot.Right = hotspot.Left + 40; hotspot.Bottom = hotspot.Top + 40;
+    if (i % 5 == 0) {
+      hotspot.Polygon = { hotspot.Left, hotspot.Top, hotspot.Right, hotspot.Top + 20, hotspot.Left, hotspot.Bottom };
+    }
+    hotspots.push_back(hotspot);
+  }
+  Picking::INDEX index;
+  Benchmark("Picking::IndexBuild/10000", 0, 0, 20, [&]() {
+    Picking::IndexBuild(&index, hotspots, 8000, 2000);
+  });
+  volatile int sink = 0;
+  Benchmark("Picking::IndexQuery/100000", 0, 0, 20, [&]() {
+    for (int i = 0; i < 100000; i++) sink += Picking::IndexQuery(&index, (i * 7919) % 8000, (i * 104729u) % 2000);
+  });
+  // the same hotspots crowded into a 400 x 100 patch, as a map of one town would be
+  vector<Picking::HOTSPOT> clustered = hotspots;
+  for (size_t i = 0; i < clustered.size(); i++) {
+    Picking::HOTSPOT *hotspot = &clustered[i];
+    hotspot->Left = 3000 + fmod(hotspot->Left, 400); hotspot->Top = 900 + fmod(hotspot->Top, 100);
+    hotspot->Right = hotspot->Left + 4; hotspot->Bottom = hotspot->Top + 4;
+    if (!hotspot->Polygon.empty()) {
+      hotspot->Polygon = { hotspot->Left, hotspot->Top, hotspot->Right, hotspot->Top + 2, hotspot->Left, hotspot->Bottom };
+    }
+  }
+  Picking::INDEX crowded;
+  Benchmark("Picking::IndexBuild/clustered-10000", 0, 0, 20, [&]() {
+    Picking::IndexBuild(&crowded, clustered, 8000, 2000);
+  });
+  Benchmark("Picking::IndexQuery/clustered-100000", 0, 0, 20, [&]() {
+    for (int i = 0; i < 100000; i++) sink += Picking::IndexQuery(&crowded, 3000 + (i * 7919) % 400, 900 + (i * 104729u) % 100);
+  });
+  SoftRender::TEXTURE texture = { nullptr, 8000, 2000 };
+  SoftRender::CAMERA camera; SoftRender::CameraFromAngles(45, 5, 60, 1, &camera);
+  vector<double> screen(2 * 10000), texels(2 * 10000);
+  for (int i = 0; i < 10000; i++) { screen[i * 2] = i % 640; screen[i * 2 + 1] = (i / 640) % 480; }
+  Benchmark("Picking::TexelsFromScreen/10000", 0, 0, 20, [&]() {
+    Picking::TexelsFromScreen(&texture, &camera, screen.data(), 10000, 640, 480, texels.data(), nullptr);
+  });
+}
+
+void BenchmarkOverlay() {
+  // 100000 markers scattered over an 8000 x 2000 panorama, placed once, culled per frame
+  Overlay::MARKERS markers; unsigned state = 88172645u;
+  for (int i = 0; i < 100000; i++) {
+    state ^= state << 13; state ^= state >> 17; state ^= state << 5;
+    markers.Name.push_back(to_string(i));
+    markers.TexX.push_back(state % 8000); markers.TexY.push_back((state >> 13) % 2000);
+    markers.Icon.push_back(i % 4);
+  }
+  markers.PlacedWidth = markers.PlacedHeight = -1;
+  SoftRender::TEXTURE texture = { nullptr, 8000, 2000 };
+  Benchmark("Overlay::Place/100000", 0, 0, 20, [&]() {
+    markers.PlacedWidth = -1; Overlay::Place(&markers, &texture);
+  });
+  SoftRender::CAMERA camera; SoftRender::CameraFromAngles(45, 5, 60, 1, &camera);
+  vector<float> visible;
+  Benchmark("Overlay::Cull/100000", 0, 0, 100, [&]() {
+    visible.clear(); Overlay::Cull(&markers, &camera, 0.05f, 0.05f, &visible);
+  });
+}
+
+void BenchmarkAtlas() {
+  // 256 cursor sized sprites into an atlas that starts small and has to grow
+  vector<unsigned char> sprite = SyntheticPanorama(32, 32);
+  Atlas::ATLAS atlas;
+  Benchmark("Atlas::Pack/256x32x32", 0, 0, 20, [&]() {
+    Atlas::Create(&atlas, 256, 256, 4096);
+    for (int i = 0; i < 256; i++) Atlas::Pack(&atlas, to_string(i), sprite.data(), 32, 32);
+  });
+  // the same, then half released and the rest packed again from scratch
+  Benchmark("Atlas::PackRepack/256x32x32", 0, 0, 20, [&]() {
+    Atlas::Create(&atlas, 256, 256, 4096);
+    for (int i = 0; i < 256; i++) Atlas::Pack(&atlas, to_string(i), sprite.data(), 32, 32);
+    for (int i = 0; i < 256; i += 2) Atlas::Release(&atlas, i);
+    Atlas::Repack(&atlas);
+  });
+}
+
+void BenchmarkProcessSnapshot() {
+  // the whole table once versus a scan per question
+  Benchmark("ProcessSnapshotCreate", 0, 0, 20, [&]() {
+    CrossProcess::FreeProcessSnapshot(CrossProcess::ProcessSnapshotCreate());
+  });
+  Benchmark("ProcIdFromParentProcId", 0, 0, 20, [&]() {
+    CrossProcess::PROCID *procId = nullptr; int size = 0;
+    CrossProcess::ProcIdFromParentProcId(CrossProcess::ProcIdFromSelf(), &procId, &size);
+    CrossProcess::FreeProcId(procId);
+  });
+  CrossProcess::PROCSNAPSHOT snapshot = CrossProcess::ProcessSnapshotCreate();
+  Benchmark("ProcessSnapshotChildren/1000", 0, 0, 20, [&]() {
+    for (int i = 0; i < 1000; i++) {
+      CrossProcess::PROCID *procId = nullptr; int size = 0;
+      CrossProcess::ProcessSnapshotChildren(snapshot, CrossProcess::ProcIdFromSelf(), &procId, &size);
+      CrossProcess::FreeProcId(procId);
+    }
+  });
+  CrossProcess::FreeProcessSnapshot(snapshot);
+}
+
+void BenchmarkProcessInfoLazy() {
+  // one field of one process, what most callers ask a PROCINFO for
+  CrossProcess::PROCID procId = CrossProcess::ProcIdFromSelf();
+  Benchmark("ProcInfoFromProcId/exe", 0, 0, 200, [&]() {
+    CrossProcess::PROCINFO procInfo = CrossProcess::ProcInfoFromProcId(procId);
+    CrossProcess::ExecutableImageFilePath(procInfo);
+    CrossProcess::FreeProcInfo(procInfo);
+  });
+  // children of every process, one field filled for all of them at once
+  CrossProcess::PROCID *pid = nullptr; int size = 0;
+  CrossProcess::ProcIdEnumerate(&pid, &size);
+  std::vector<CrossProcess::PROCINFO> procInfo(size);
+  Benchmark("ProcInfoLoad/children-of-all", 0, 0, 50, [&]() {
+    for (int i = 0; i < size; i++) procInfo[i] = CrossProcess::ProcInfoFromProcId(pid[i]);
+    CrossProcess::ProcInfoLoad(procInfo.data(), size, CrossProcess::PROCINFO_CHILDREN, 1);
+    for (int i = 0; i < size; i++) CrossProcess::FreeProcInfo(procInfo[i]);
+  });
+  // everything about every process, the per process reads spread over all threads
+  Benchmark("ProcInfoLoad/all-fields-all-threads", 0, 0, 20, [&]() {
+    for (int i = 0; i < size; i++) procInfo[i] = CrossProcess::ProcInfoFromProcId(pid[i]);
+    CrossProcess::ProcInfoLoad(procInfo.data(), size, CrossProcess::PROCINFO_ALL, 0);
+    for (int i = 0; i < size; i++) CrossProcess::FreeProcInfo(procInfo[i]);
+  });
+  CrossProcess::FreeProcId(pid);
+}
+
+void BenchmarkProcessInfoThreaded() {
+  // the same introspection from every hardware thread at once
+  CrossProcess::PROCID procId = CrossProcess::ProcIdFromSelf();
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  Benchmark("ProcInfoFromProcId/all-threads", 0, 0, 20, [&]() {
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < threads; i++) {
+      workers.push_back(std::thread([procId]() {
+        CrossProcess::PROCINFO procInfo = CrossProcess::ProcInfoFromProcIdEx(procId, CrossProcess::PROCINFO_ALL);
+        CrossProcess::FreeProcInfo(procInfo);
+      }));
+    }
+    for (unsigned i = 0; i < threads; i++) workers[i].join();
+  });
+}
+
+void BenchmarkProcessExecute() {
+  // launch to completion with output captured, the latency a dialog launch pays
+  #if defined(_WIN32)
+  const char *command = "cmd /c echo panoview";
+  #else
+  const char *command = "echo panoview";
+  #endif
+  Benchmark("ProcessExecute/echo", 0, 0, 50, [&]() {
+    CrossProcess::PROCESS procIndex = CrossProcess::ProcessExecute(command);
+    CrossProcess::FreeExecutedProcessStandardOutput(procIndex);
+  });
+}
+
+void BenchmarkProcessStreaming() {
+  // many children writing at once, all of them read by the one reactor
+  #if defined(_WIN32)
+  const char *command = "cmd /c for /l %i in (1,1,2000) do @echo %i";
+  #else
+  const char *command = "seq 1 20000";
+  #endif
+  const int children = 16;
+  static std::atomic<int> finished; static std::atomic<long long> bytes;
+  Benchmark("ProcessExecuteStreaming/16-children", 0, 0, 10, [&]() {
+    finished = 0; bytes = 0;
+    for (int i = 0; i < children; i++) {
+      CrossProcess::ProcessExecuteStreaming(command, [](CrossProcess::PROCESS procIndex, 
+        const char *output, int length, void *userData) {
+        if (output) bytes += length; else finished++;
+      }, nullptr);
+    }
+    while (finished < children) std::this_thread::yield();
+  });
+}
+
+void BenchmarkCommandParser() {
+  string input;
+  for (int i = 0; i < 256; i++) {
+    input += "PANORAMA_TEXTURE=/some/where/panorama" + to_string(i) + ".png\n";
+    input += "PANORAMA_XANGLE=" + to_string(i % 360) + "\n";
+    input += "PANORAMA_YANGLE=" + to_string(i % 90) + "\n";
+    input += "PANORAMA_POINTER=/some/where/cursor.png\n";
+  }
+  Benchmark("EnvironFromString/1024-lines", 0, (double)input.length(), 200, [&]() {
+    string value; EnvironFromString(input, "PANORAMA_YANGLE", &value);
+  });
+}
+
+void WriteResults(std::ostream &stream) {
+  stream << "{\"commit\":\"" << PANOVIEW_COMMIT << "\",\"benchmarks\":[";
+  for (size_t i = 0; i < Results.size(); i++) {
+    const RESULT &r = Results[i];
+    double throughput = (r.Bytes > 0 && r.Median > 0) ? r.Bytes / (r.Median / 1000) / 1048576 : 0;
+    stream << (i ? ",\n" : "\n") << "{\"name\":\"" << r.Name << "\",\"megapixels\":" << r.Megapixels
+    << ",\"iterations\":" << r.Iterations << ",\"median_ms\":" << r.Median << ",\"min_ms\":" << r.Minimum
+    << ",\"mib_per_s\":" << throughput << "}";
+  }
+  stream << "\n]}" << std::endl;
+}
+
+} // anonymous namespace
+
+int main(int argc, char **argv) {
+  vector<double> sizes = { 1, 4, 16, 64 }; string output;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--sizes") == 0) {
+      sizes.clear(); vector<string> vec = StringSplit(argv[i + 1], ",");
+      for (size_t j = 0; j < vec.size(); j++) sizes.push_back(strtod(vec[j].c_str(), nullptr));
+    } else if (strcmp(argv[i], "--output") == 0) {
+      output = argv[i + 1];
+    }
+  }
+  for (size_t i = 0; i < sizes.size(); i++) {
+    BenchmarkLoadImage(sizes[i]);
+    BenchmarkSoftRender(sizes[i]);
+  }
+  #if !defined(_WIN32)
+  BenchmarkFilters(sizes.empty() ? 1 : sizes[0]);
+  #endif
+  BenchmarkMesh();
+  BenchmarkTexelUnderCursor();
+  BenchmarkPicking();
+  BenchmarkOverlay();
+  BenchmarkAtlas();
+  BenchmarkProcessSnapshot();
+  BenchmarkProcessInfoLazy();
+  BenchmarkProcessInfoThreaded();
+  BenchmarkProcessExecute();
+  BenchmarkProcessStreaming();
+  BenchmarkCommandParser();
+  if (output.empty()) {
+    WriteResults(std::cout);
+  } else {
+    std::ofstream stream(output.c_str());
+    WriteResults(stream);
+  }
+  return 0;
+}
@@ -0,0 +1,223 @@
+/*
+
+ MIT License
+
+ Copyright © 2021 Samuel Venable
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+*/
+
+#include <algorithm>
+
+#include <cstddef>
+#include <cstring>
+
+#include "atlas.h"
+
+namespace {
+
+const unsigned ALIGN = 1u << (Atlas::LEVELS - 1);
+const unsigned GUTTER = ALIGN / 2;
+
+unsigned RoundUp(unsigned value) {
+  return (value + ALIGN - 1) / ALIGN * ALIGN;
+}
+
+/* rebuilds the level 0 rectangle left, bottom to right, top in every level
+past the first from the one before it; color is weighted by alpha so that
+transparent texels, usually black, don't darken the edges of what they
+surround */
+void Downsample(Atlas::ATLAS *atlas, unsigned left, unsigned bottom, unsigned right, unsigned top) {
+  for (unsigned level = 1; level < Atlas::LEVELS; level++) {
+    unsigned width = std::max(atlas->Width >> level, 1u), height = std::max(atlas->Height >> level, 1u);
+    unsigned above = std::max(atlas->Width >> (level - 1), 1u);
+    const unsigned char *source = atlas->Levels[level - 1].data();
+    unsigned char *target = atlas->Levels[level].data();
+    unsigned first = bottom >> level, last = std::min((top + (1u << level) - 1) >> level, height);
+    unsigned begin = left >> level, end = std::min((right + (1u << level) - 1) >> level, width);
+    for (unsigned y = first; y < last; y++) {
+      for (unsigned x = begin; x < end; x++) {
+        unsigned color[3] = { 0, 0, 0 }, alpha = 0;
+        for (unsigned i = 0; i < 4; i++) {
+          const unsigned char *texel = source + ((size_t)(y * 2 + i / 2) * above + x * 2 + i % 2) * 4;
+          for (int c = 0; c < 3; c++) color[c] += texel[c] * texel[3];
+          alpha += texel[3];
+        }
+        unsigned char *out = target + ((size_t)y * width + x) * 4;
+        for (int c = 0; c < 3; c++) out[c] = alpha ? (unsigned char)((color[c] + alpha / 2) / alpha) : 0;
+        out[3] = (unsigned char)((alpha + 2) / 4);
+      }
+    }
+  }
+}
+
+void Resize(Atlas::ATLAS *atlas, unsigned width, unsigned height) {
+  std::vector<unsigned char> pixels((size_t)width * height * 4);
+  for (unsigned y = 0; y < atlas->Height; y++) {
+    memcpy(&pixels[(size_t)y * width * 4], &atlas->Levels[0][(size_t)y * atlas->Width * 4], 
+    (size_t)atlas->Width * 4);
+  }
+  atlas->Levels[0].swap(pixels);
+  atlas->Width = width; atlas->Height = height;
+  for (unsigned level = 1; level < Atlas::LEVELS; level++) {
+    atlas->Levels[level].assign((size_t)std::max(width >> level, 1u) * 
+    std::max(height >> level, 1u) * 4, 0);
+  }
+  Downsample(atlas, 0, 0, width, height);
+  atlas->Resized = true;
+}
+
+/* doubles whichever side is shorter, or the width if the cell is wider
+than the atlas; a new shelf only ever needs more height */
+bool Grow(Atlas::ATLAS *atlas, unsigned cellwidth) {
+  unsigned width = atlas->Width, height = atlas->Height;
+  if (cellwidth > width || width < height) width *= 2; else height *= 2;
+  if (width > atlas->MaximumSize || height > atlas->MaximumSize) return false;
+  Resize(atlas, width, height);
+  return true;
+}
+
+/* finds room for a width by height image, growing the atlas if it has
+to, and copies it in with its gutter */
+bool Place(Atlas::ATLAS *atlas, const unsigned char *pixels, unsigned width, unsigned height,
+  Atlas::SPRITE *placed) {
+  unsigned cellwidth = RoundUp(width + GUTTER * 2), cellheight = RoundUp(height + GUTTER * 2);
+  int best = -1;
+  while (best < 0) {
+    // the lowest shelf that fits wastes the least height
+    for (size_t i = 0; i < atlas->Shelves.size(); i++) {
+      const Atlas::SHELF &shelf = atlas->Shelves[i];
+      if (shelf.Height >= cellheight && atlas->Width - shelf.Used >= cellwidth &&
+        (best < 0 || shelf.Height < atlas->Shelves[best].Height)) best = (int)i;
+    }
+    if (best >= 0) break;
+    unsigned top = atlas->Shelves.empty() ? 0 : atlas->Shelves.back().Y + atlas->Shelves.back().Height;
+    if (cellwidth <= atlas->Width && top + cellheight <= atlas->Height) {
+      Atlas::SHELF shelf = { top, cellheight, 0 };
+      atlas->Shelves.push_back(shelf);
+      best = (int)atlas->Shelves.size() - 1;
+    } else if (!Grow(atlas, cellwidth)) {
+      return false;
+    }
+  }
+  Atlas::SHELF *shelf = &atlas->Shelves[best];
+  Atlas::SPRITE sprite = { shelf->Used + GUTTER, shelf->Y + GUTTER, width, height };
+  shelf->Used += cellwidth;
+  // the gutter repeats the outermost texels, clamp to edge within the atlas
+  for (unsigned y = sprite.Y - GUTTER; y < shelf->Y + cellheight; y++) {
+    unsigned row = (unsigned)std::min(std::max((int)y - (int)sprite.Y, 0), (int)height - 1);
+    unsigned char *target = &atlas->Levels[0][((size_t)y * atlas->Width + sprite.X - GUTTER) * 4];
+    for (unsigned x = 0; x < cellwidth; x++) {
+      unsigned column = (unsigned)std::min(std::max((int)x - (int)GUTTER, 0), (int)width - 1);
+      memcpy(target + x * 4, pixels + ((size_t)row * width + column) * 4, 4);
+    }
+  }
+  Downsample(atlas, sprite.X - GUTTER, shelf->Y, sprite.X - GUTTER + cellwidth, shelf->Y + cellheight);
+  if (atlas->DirtyBottom == atlas->DirtyTop) {
+    atlas->DirtyBottom = shelf->Y; atlas->DirtyTop = shelf->Y + cellheight;
+  } else {
+    atlas->DirtyBottom = std::min(atlas->DirtyBottom, shelf->Y);
+    atlas->DirtyTop = std::max(atlas->DirtyTop, shelf->Y + cellheight);
+  }
+  *placed = sprite;
+  return true;
+}
+
+} // anonymous namespace
+
+namespace Atlas {
+
+void Create(ATLAS *atlas, unsigned width, unsigned height, unsigned maximum) {
+  atlas->Width = atlas->Height = 0;
+  atlas->MaximumSize = maximum;
+  atlas->Levels[0].clear();
+  atlas->Shelves.clear(); atlas->Sprites.clear(); atlas->Names.clear();
+  atlas->DirtyBottom = atlas->DirtyTop = 0;
+  Resize(atlas, RoundUp(std::max(width, ALIGN)), RoundUp(std::max(height, ALIGN)));
+}
+
+int Find(const ATLAS *atlas, const std::string &name) {
+  std::map<std::string, int>::const_iterator it = atlas->Names.find(name);
+  return (it == atlas->Names.end()) ? -1 : it->second;
+}
+
+int Pack(ATLAS *atlas, const std::string &name, const unsigned char *pixels,
+  unsigned width, unsigned height) {
+  if (!width || !height) return -1;
+  SPRITE sprite;
+  if (!Place(atlas, pixels, width, height, &sprite)) return -1;
+  // the first released number, if any, else a new one
+  size_t index = 0;
+  while (index < atlas->Sprites.size() && atlas->Sprites[index].Width) index++;
+  if (index == atlas->Sprites.size()) atlas->Sprites.push_back(sprite);
+  else atlas->Sprites[index] = sprite;
+  atlas->Names[name] = (int)index;
+  return (int)index;
+}
+
+void Release(ATLAS *atlas, int sprite) {
+  if (sprite < 0 || sprite >= (int)atlas->Sprites.size()) return;
+  SPRITE released = { 0, 0, 0, 0 };
+  atlas->Sprites[sprite] = released;
+  for (std::map<std::string, int>::iterator it = atlas->Names.begin(); it != atlas->Names.end();) {
+    if (it->second == sprite) it = atlas->Names.erase(it); else it++;
+  }
+}
+
+bool Repack(ATLAS *atlas) {
+  std::vector<int> order;
+  for (size_t i = 0; i < atlas->Sprites.size(); i++)
+    if (atlas->Sprites[i].Width) order.push_back((int)i);
+  std::stable_sort(order.begin(), order.end(), [atlas](int a, int b) {
+    return atlas->Sprites[a].Height > atlas->Sprites[b].Height;
+  });
+  ATLAS packed; Create(&packed, ALIGN, ALIGN, atlas->MaximumSize);
+  SPRITE released = { 0, 0, 0, 0 };
+  packed.Sprites.assign(atlas->Sprites.size(), released);
+  std::vector<unsigned char> pixels;
+  for (size_t i = 0; i < order.size(); i++) {
+    const SPRITE &sprite = atlas->Sprites[order[i]];
+    // level 0 without the gutter is the image as it was packed
+    pixels.resize((size_t)sprite.Width * sprite.Height * 4);
+    for (unsigned y = 0; y < sprite.Height; y++) {
+      memcpy(&pixels[(size_t)y * sprite.Width * 4],
+      &atlas->Levels[0][((size_t)(sprite.Y + y) * atlas->Width + sprite.X) * 4], (size_t)sprite.Width * 4);
+    }
+    if (!Place(&packed, pixels.data(), sprite.Width, sprite.Height, &packed.Sprites[order[i]])) return false;
+  }
+  packed.Names.swap(atlas->Names);
+  *atlas = std::move(packed);
+  atlas->DirtyBottom = atlas->DirtyTop = 0;
+  atlas->Resized = true;
+  return true;
+}
+
+void TexCoords(const ATLAS *atlas, int sprite, float *s0, float *t0, float *s1, float *t1) {
+  const SPRITE &rect = atlas->Sprites[sprite];
+  *s0 = (float)rect.X / atlas->Width; *s1 = (float)(rect.X + rect.Width) / atlas->Width;
+  *t0 = (float)rect.Y / atlas->Height; *t1 = (float)(rect.Y + rect.Height) / atlas->Height;
+}
+
+void Clean(ATLAS *atlas) {
+  atlas->DirtyBottom = atlas->DirtyTop = 0;
+  atlas->Resized = false;
+}
+
+} // namespace Atlas
@@ -0,0 +1,97 @@
+/*
+
+ MIT License
+
+ Copyright © 2021 Samuel Venable
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+*/
+
+/* small images the viewer draws over the panorama (cursors, marker icons)
+packed into one mipmapped texture, so switching between them is a change
+of texture coordinates and not a new texture. Only the pixels live here,
+the caller owns the GL texture and uploads what Pack() dirtied */
+
+#include <string>
+#include <vector>
+#include <map>
+
+namespace Atlas {
+
+/* mip levels kept; cells are aligned to and padded by a multiple of
+1 << (LEVELS - 1) texels so no level ever averages two sprites together */
+const unsigned LEVELS = 4;
+
+/* texels of level 0, the image itself without the gutter around it;
+a released sprite is all zeros */
+typedef struct {
+  unsigned X, Y;
+  unsigned Width, Height;
+} SPRITE;
+
+typedef struct {
+  unsigned Y, Height;
+  unsigned Used;
+} SHELF;
+
+/* Levels hold RGBA bottom row first, the order LoadImage() returns and
+glTexImage2D() expects; rows DirtyBottom up to DirtyTop of level 0 have
+changed since the last Clean(), all of them if Resized */
+typedef struct {
+  unsigned Width, Height, MaximumSize;
+  std::vector<unsigned char> Levels[LEVELS];
+  std::vector<SHELF> Shelves;
+  std::vector<SPRITE> Sprites;
+  std::map<std::string, int> Names;
+  unsigned DirtyBottom, DirtyTop;
+  bool Resized;
+} ATLAS;
+
+/* empty width by height atlas that may grow up to maximum on either side */
+void Create(ATLAS *atlas, unsigned width, unsigned height, unsigned maximum);
+
+/* sprite previously packed under name, or -1 */
+int Find(const ATLAS *atlas, const std::string &name);
+
+/* copies a width by height RGBA image in (same row order as Levels) and
+returns its sprite, growing the atlas when no shelf has room; returns -1
+when it would have to grow past the maximum. Sprite numbers stay valid
+until the sprite is released, texture coordinates don't if it grows */
+int Pack(ATLAS *atlas, const std::string &name, const unsigned char *pixels,
+  unsigned width, unsigned height);
+
+/* forgets a sprite and its name, Pack() may hand the number out again;
+the texels it covered are only reclaimed by the next Repack() */
+void Release(ATLAS *atlas, int sprite);
+
+/* packs the sprites still held into a fresh atlas, tallest first, and
+takes its place, so released sprites stop taking up room and the atlas
+may shrink; sprite numbers are kept, texture coordinates aren't and all
+of it is marked Resized. Returns false, leaving the atlas as it was, if
+they no longer fit within the maximum */
+bool Repack(ATLAS *atlas);
+
+/* the sprite's corners in texture coordinates at the atlas' current size */
+void TexCoords(const ATLAS *atlas, int sprite, float *s0, float *t0, float *s1, float *t1);
+
+/* marks everything as uploaded */
+void Clean(ATLAS *atlas);
+
+} // namespace Atlas
@@ -0,0 +1,120 @@
+/*
+
+ MIT License
+
+ Copyright © 2021 Samuel Venable
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+*/
+
+#include <cstddef>
+#include <cmath>
+
+#include "camera.h"
+
+namespace {
+
+// how long motion has to pause before the camera starts to coast, longer
+// than the report interval of a 125 Hz mouse so it doesn't coast between
+// reports; and the time constant of the velocity estimate
+const double COAST_DELAY        = 20;
+const double VELOCITY_SMOOTHING = 30;
+const double MAXIMUM_STALL      = 250;
+
+double ClampVertical(Camera::STATE *camera, double yangle) {
+  double limit = camera->MaximumVerticalAngle;
+  if (yangle > limit || yangle < -limit) camera->YVelocity = 0;
+  return std::fmin(std::fmax(yangle, -limit), limit);
+}
+
+void Step(Camera::STATE *camera) {
+  const double dt = Camera::STEP / 1000;
+  double end = camera->Time + Camera::STEP;
+  double dx = 0, dy = 0; size_t used = 0;
+  while (used < camera->Pending.size() && camera->Pending[used].Time < end) {
+    dx += camera->Pending[used].DeltaX; dy += camera->Pending[used].DeltaY;
+    camera->LastMotion = camera->Pending[used].Time; used++;
+  }
+  camera->Pending.erase(camera->Pending.begin(), camera->Pending.begin() + used);
+  camera->PreviousXAngle = camera->XAngle;
+  camera->PreviousYAngle = camera->YAngle;
+  if (used || end - camera->LastMotion < COAST_DELAY) {
+    // follow the input exactly and keep a running estimate of its rate
+    double blend = 1 - std::exp(-Camera::STEP / VELOCITY_SMOOTHING);
+    camera->XVelocity += (dx / dt - camera->XVelocity) * blend;
+    camera->YVelocity += (dy / dt - camera->YVelocity) * blend;
+    camera->XAngle += dx;
+    camera->YAngle = ClampVertical(camera, camera->YAngle + dy);
+  } else {
+    double decay = std::exp(-camera->Damping * dt);
+    camera->XVelocity *= decay; camera->YVelocity *= decay;
+    if (std::fabs(camera->XVelocity) < 0.01) camera->XVelocity = 0;
+    if (std::fabs(camera->YVelocity) < 0.01) camera->YVelocity = 0;
+    camera->XAngle += camera->XVelocity * dt;
+    camera->YAngle = ClampVertical(camera, camera->YAngle + camera->YVelocity * dt);
+  }
+  // keep both angles near [0, 360) without moving them apart
+  double turns = std::floor(camera->PreviousXAngle / 360) * 360;
+  camera->PreviousXAngle -= turns; camera->XAngle -= turns;
+  camera->Time = end;
+}
+
+} // anonymous namespace
+
+namespace Camera {
+
+void Reset(STATE *camera, double xangle, double yangle, double damping, double time) {
+  camera->XAngle = camera->PreviousXAngle = xangle;
+  camera->YAngle = camera->PreviousYAngle = yangle;
+  camera->XVelocity = camera->YVelocity = 0;
+  camera->Time = camera->LastMotion = time;
+  camera->Alpha = 0;
+  camera->Damping = damping;
+  camera->Pending.clear();
+}
+
+void AddMotion(STATE *camera, double time, double dx, double dy) {
+  MOTION motion = { std::fmax(time, camera->Time), dx, dy };
+  std::vector<MOTION>::iterator it = camera->Pending.end();
+  while (it != camera->Pending.begin() && (it - 1)->Time > motion.Time) it--;
+  camera->Pending.insert(it, motion);
+}
+
+void Advance(STATE *camera, double now) {
+  if (now - camera->Time > MAXIMUM_STALL) {
+    camera->Time = now - STEP;
+    camera->XVelocity = camera->YVelocity = 0;
+    for (size_t i = 0; i < camera->Pending.size(); i++)
+      camera->Pending[i].Time = std::fmax(camera->Pending[i].Time, camera->Time);
+  }
+  while (camera->Time + STEP <= now) Step(camera);
+  camera->Alpha = (now - camera->Time) / STEP;
+  camera->YAngle = ClampVertical(camera, camera->YAngle);
+  camera->PreviousYAngle = std::fmin(std::fmax(camera->PreviousYAngle,
+    -camera->MaximumVerticalAngle), camera->MaximumVerticalAngle);
+}
+
+void Interpolated(const STATE *camera, double *xangle, double *yangle) {
+  double x = camera->PreviousXAngle + (camera->XAngle - camera->PreviousXAngle) * camera->Alpha;
+  *xangle = std::fmod(std::fmod(x, 360) + 360, 360);
+  *yangle = camera->PreviousYAngle + (camera->YAngle - camera->PreviousYAngle) * camera->Alpha;
+}
+
+} // namespace Camera
@@ -0,0 +1,72 @@
+/*
+
+ MIT License
+
+ Copyright © 2021 Samuel Venable
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+*/
+
+/* mouse look camera with velocity and damping, integrated in fixed steps
+on the motion's own timestamps so the path it takes doesn't depend on how
+often the viewer draws; angles are degrees, times FrameTimer::Now() ms */
+
+#include <vector>
+
+namespace Camera {
+
+/* integration step, 240 Hz */
+const double STEP = 1000.0 / 240;
+
+typedef struct {
+  double Time;
+  double DeltaX;
+  double DeltaY;
+} MOTION;
+
+typedef struct {
+  double XAngle;                  // not wrapped, so interpolation never crosses the seam
+  double YAngle;
+  double PreviousXAngle;
+  double PreviousYAngle;
+  double XVelocity;               // degrees per second
+  double YVelocity;
+  double Time;                    // start of the next step to integrate
+  double LastMotion;              // time of the newest motion applied
+  double Alpha;                   // fraction of a step since the last one
+  double Damping;                 // per second, 0 stops dead when motion does
+  double MaximumVerticalAngle;
+  std::vector<MOTION> Pending;    // queued by AddMotion(), sorted by time
+} STATE;
+
+void Reset(STATE *camera, double xangle, double yangle, double damping, double time);
+
+/* motion more recent than the last integrated step is applied in the step
+its timestamp falls in, older motion in the next step */
+void AddMotion(STATE *camera, double time, double dx, double dy);
+
+/* integrates every whole step up to now; a stall longer than a quarter
+second is skipped rather than replayed step by step */
+void Advance(STATE *camera, double now);
+
+/* state between the last two steps at Alpha, xangle wrapped to [0, 360) */
+void Interpolated(const STATE *camera, double *xangle, double *yangle);
+
+} // namespace Camera
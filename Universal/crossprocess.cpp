@@ -31,8 +31,11 @@
 #include <sstream>
 #include <fstream>
 #include <thread>
+#include <atomic>
+#include <future>
 #include <string>
 #include <vector>
+#include <memory>
 #include <mutex>
 
 #include <cstdlib>
@@ -41,6 +44,7 @@
 #include <cstring>
 #include <climits>
 #include <cstdio>
+#include <cerrno>
 
 #include "crossprocess.h"
 #if defined(XPROCESS_WIN32EXE_INCLUDES)
@@ -49,12 +53,15 @@
 #endif
 
 #if !defined(_WIN32)
+#include <spawn.h>
+#include <poll.h>
 #include <signal.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <dirent.h>
 #endif
 
 #if defined(_WIN32)
@@ -66,10 +73,14 @@
 #elif (defined(__APPLE__) && defined(__MACH__))
 #include <sys/sysctl.h>
 #include <sys/proc_info.h>
+#include <sys/event.h>
 #include <libproc.h>
 #elif (defined(__linux__) && !defined(__ANDROID__))
-#include <proc/readproc.h>
+#include <sys/syscall.h>
+#include <sys/epoll.h>
+#include <poll.h>
 #elif defined(__FreeBSD__)
+#include <sys/event.h>
 #include <sys/socket.h>
 #include <sys/sysctl.h>
 #include <sys/param.h>
@@ -80,11 +91,17 @@
 #elif defined(__DragonFly__)
 #include <sys/param.h>
 #include <sys/sysctl.h>
+#include <sys/event.h>
 #include <sys/user.h>
 #include <libutil.h>
 #include <kvm.h>
 #endif
 
+// pidfd_open() is Linux 5.3, the number is the same on every architecture
+#if (defined(__linux__) && !defined(__ANDROID__)) && !defined(SYS_pidfd_open)
+#define SYS_pidfd_open 434
+#endif
+
 using CrossProcess::PROCID;
 #if defined(XPROCESS_GUIWINDOW_IMPL)
 using CrossProcess::WINDOWID;
@@ -256,10 +273,7 @@ enum MEMTYP {
   MEMENV
 };
 
-static std::vector<std::string> CmdEnvVec1;
-void CmdEnvFromProcId(PROCID procId, char ***buffer, int *size, int type) {
-  *buffer = nullptr; *size = 0;
-  CmdEnvVec1.clear(); int i = 0;
+void CmdEnvFromProcId(PROCID procId, std::vector<std::string> *vec, int type) {
   if (!CrossProcess::ProcIdExists(procId)) return;
   int argmax = 0, nargs = 0; std::size_t s = 0;
   char *procargs = nullptr, *sp = nullptr, *cp = nullptr; 
@@ -294,26 +308,339 @@ void CmdEnvFromProcId(PROCID procId, char ***buffer, int *size, int type) {
   sp = cp; int j = 0;
   while (*sp != '\0' && sp < &procargs[s]) {
     if (type && j >= nargs) { 
-      CmdEnvVec1.push_back(sp); i++;
+      vec->push_back(sp);
     } else if (!type && j < nargs) {
-      CmdEnvVec1.push_back(sp); i++;
+      vec->push_back(sp);
     }
     sp += strlen(sp) + 1; j++;
   }
   if (procargs) free(procargs);
-  std::vector<char *> CmdEnvVec2;
-  for (int j = 0; j < CmdEnvVec1.size(); j++)
-    CmdEnvVec2.push_back((char *)CmdEnvVec1[j].c_str());
-  char **arr = new char *[CmdEnvVec2.size()]();
-  std::copy(CmdEnvVec2.begin(), CmdEnvVec2.end(), arr);
-  *buffer = arr; *size = i;
+}
+#endif
+
+#if (defined(__linux__) && !defined(__ANDROID__))
+/* /proc read directly: listing it is a getdents64 loop over the directory
+with no per process reads, each process' files are read only when the
+caller asks for what is in them */
+struct linux_dirent64 {
+  std::uint64_t d_ino;
+  std::int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+void ProcScan(std::vector<PROCID> *vec) {
+  int fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd == -1) return;
+  alignas(8) char buffer[65536]; long nread = 0;
+  while ((nread = syscall(SYS_getdents64, fd, buffer, sizeof(buffer))) > 0) {
+    for (long offset = 0; offset < nread;) {
+      linux_dirent64 *entry = (linux_dirent64 *)(buffer + offset);
+      offset += entry->d_reclen;
+      // thread group leaders are the all digit names, threads are under task/
+      const char *name = entry->d_name; if (*name < '1' || *name > '9') continue;
+      PROCID procId = 0; for (; *name >= '0' && *name <= '9'; name++) procId = procId * 10 + (*name - '0');
+      if (!*name) vec->push_back(procId);
+    }
+  }
+  close(fd);
+}
+
+/* whole file, /proc reports a size of 0 so it's read until it ends; it
+is read straight into str, whose capacity is kept from call to call */
+bool ProcRead(PROCID procId, const char *file, std::string *str) {
+  char path[64]; snprintf(path, sizeof(path), "/proc/%d/%s", (int)procId, file);
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) { str->clear(); return false; }
+  str->resize(std::max(str->capacity(), (std::size_t)4096));
+  std::size_t length = 0; ssize_t nread = 0;
+  while ((nread = pread(fd, &(*str)[length], str->size() - length, (off_t)length)) > 0) {
+    length += nread;
+    if (length == str->size()) str->resize(str->size() * 2);
+  }
+  close(fd);
+  str->resize(length);
+  return nread == 0;
+}
+
+/* the parent from stat; the name before it may hold spaces and
+parentheses, so parsing starts after the last ')' */
+bool ProcParent(PROCID procId, PROCID *parentProcId) {
+  static thread_local std::string stat; if (!ProcRead(procId, "stat", &stat)) return false;
+  std::size_t pos = stat.rfind(')'); if (pos == std::string::npos) return false;
+  char state = 0; int ppid = 0;
+  if (sscanf(stat.c_str() + pos + 1, " %c %d", &state, &ppid) != 2) return false;
+  *parentProcId = ppid;
+  return true;
+}
+
+/* cmdline and environ, which are nul separated */
+void ProcStrings(PROCID procId, const char *file, std::vector<std::string> *vec) {
+  static thread_local std::string str; if (!ProcRead(procId, file, &str)) return;
+  for (std::size_t pos = 0; pos < str.length();) {
+    std::size_t end = str.find('\0', pos);
+    if (end == std::string::npos) end = str.length();
+    vec->push_back(str.substr(pos, end - pos));
+    pos = end + 1;
+  }
 }
 #endif
 
 #if defined(__DragonFly__)
-kvm_t *kd = nullptr;
+thread_local kvm_t *kd = nullptr;
+#endif
+
+/* splits count items into chunks that worker threads pull from a counter,
+threads <= 0 uses every hardware thread */
+template<typename ChunkFunc>
+void ForEachChunk(std::size_t count, std::size_t chunk, int threads, ChunkFunc func) {
+  std::size_t chunks = (count + chunk - 1) / chunk;
+  if (chunks == 0) return;
+  if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = (int)std::min((std::size_t)threads, chunks);
+  std::atomic<std::size_t> next(0);
+  auto worker = [&]() {
+    std::size_t i;
+    while ((i = next.fetch_add(1)) < chunks)
+      func(i * chunk, std::min((i + 1) * chunk, count));
+  };
+  std::vector<std::thread> pool;
+  for (int i = 1; i < threads; i++)
+    pool.emplace_back(worker);
+  worker();
+  for (std::size_t i = 0; i < pool.size(); i++)
+    pool[i].join();
+}
+
+/* the process table at one instant, one row per process sorted by pid;
+Children holds row numbers grouped by parent, so the rows whose parent is
+Parents[j] are Children[ChildBegin[j]] up to Children[ChildBegin[j + 1]] */
+typedef struct {
+  std::vector<PROCID> ProcId;
+  std::vector<PROCID> ParentProcId;
+  std::vector<std::size_t> ExeOffset;
+  std::string Exe;                       // every path, nul terminated, back to back
+  std::vector<PROCID> Parents;
+  std::vector<int> ChildBegin;
+  std::vector<int> Children;
+} SNAPSHOT;
+
+void SnapshotAdd(SNAPSHOT *snapshot, PROCID procId, PROCID parentProcId, const char *exe) {
+  snapshot->ProcId.push_back(procId);
+  snapshot->ParentProcId.push_back(parentProcId);
+  snapshot->ExeOffset.push_back(snapshot->Exe.length());
+  snapshot->Exe.append(exe ? exe : "");
+  snapshot->Exe.push_back('\0');
+}
+
+/* one pass over the system's process table; paths cost a call per
+process on most platforms, so they're only read if asked for */
+void SnapshotTake(SNAPSHOT *snapshot, bool exe) {
+  #if defined(_WIN32)
+  HANDLE hp = CreateToolhelp32Snapshot(TH32CS_SNAPPROCESS, 0);
+  PROCESSENTRY32W pe = { 0 };
+  pe.dwSize = sizeof(PROCESSENTRY32W);
+  if (Process32FirstW(hp, &pe)) {
+    do {
+      std::string path;
+      if (exe) {
+        // ExeFromProcId() would enumerate every process again to check this one exists
+        HANDLE proc = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, false, pe.th32ProcessID);
+        wchar_t buffer[MAX_PATH]; DWORD size = MAX_PATH;
+        if (proc && QueryFullProcessImageNameW(proc, 0, buffer, &size)) path = narrow(buffer);
+        else path = narrow(pe.szExeFile);
+        if (proc) CloseHandle(proc);
+      }
+      SnapshotAdd(snapshot, pe.th32ProcessID, pe.th32ParentProcessID, path.c_str());
+    } while (Process32NextW(hp, &pe));
+  }
+  CloseHandle(hp);
+  #elif (defined(__APPLE__) && defined(__MACH__))
+  // the whole table in one sysctl, instead of proc_pidinfo() for each pid
+  int mib[3] = { CTL_KERN, KERN_PROC, KERN_PROC_ALL }; std::size_t s = 0;
+  std::vector<kinfo_proc> proc_info;
+  do {
+    if (sysctl(mib, 3, nullptr, &s, nullptr, 0) == -1) return;
+    proc_info.resize(s / sizeof(kinfo_proc) + 16); s = proc_info.size() * sizeof(kinfo_proc);
+  } while (sysctl(mib, 3, &proc_info[0], &s, nullptr, 0) == -1 && errno == ENOMEM);
+  proc_info.resize(s / sizeof(kinfo_proc));
+  for (std::size_t j = 0; j < proc_info.size(); j++) {
+    char path[PROC_PIDPATHINFO_MAXSIZE] = { 0 };
+    if (exe) proc_pidpath(proc_info[j].kp_proc.p_pid, path, sizeof(path));
+    SnapshotAdd(snapshot, proc_info[j].kp_proc.p_pid, proc_info[j].kp_eproc.e_ppid, path);
+  }
+  #elif (defined(__linux__) && !defined(__ANDROID__))
+  // the reads for each pid are independent, so big tables are split over threads
+  std::vector<PROCID> all; ProcScan(&all);
+  std::vector<PROCID> ppid(all.size(), -1); std::vector<std::string> path(exe ? all.size() : 0);
+  ForEachChunk(all.size(), 256, (all.size() < 1024) ? 1 : 0, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t j = begin; j < end; j++) {
+      if (!ProcParent(all[j], &ppid[j])) { ppid[j] = -1; continue; }
+      if (exe) {
+        char link[64]; snprintf(link, sizeof(link), "/proc/%d/exe", (int)all[j]);
+        char buffer[PATH_MAX]; ssize_t length = readlink(link, buffer, sizeof(buffer) - 1);
+        if (length > 0) path[j].assign(buffer, length);
+      }
+    }
+  });
+  for (std::size_t j = 0; j < all.size(); j++)
+    if (ppid[j] != -1) SnapshotAdd(snapshot, all[j], ppid[j], exe ? path[j].c_str() : "");
+  #elif defined(__FreeBSD__)
+  int cntp = 0; if (kinfo_proc *proc_info = kinfo_getallproc(&cntp)) {
+    for (int j = 0; j < cntp; j++) {
+      SnapshotAdd(snapshot, proc_info[j].ki_pid, proc_info[j].ki_ppid, 
+      exe ? CrossProcess::ExeFromProcId(proc_info[j].ki_pid) : nullptr);
+    }
+    free(proc_info);
+  }
+  #elif defined(__DragonFly__)
+  char errbuf[_POSIX2_LINE_MAX];
+  kinfo_proc *proc_info = nullptr; 
+  const char *nlistf, *memf; nlistf = memf = "/dev/null";
+  kd = kvm_openfiles(nlistf, memf, nullptr, O_RDONLY, errbuf); if (!kd) return;
+  int cntp = 0; if ((proc_info = kvm_getprocs(kd, KERN_PROC_ALL, 0, &cntp))) {
+    for (int j = 0; j < cntp; j++) {
+      if (proc_info[j].kp_pid < 0) continue;
+      SnapshotAdd(snapshot, proc_info[j].kp_pid, proc_info[j].kp_ppid, 
+      exe ? CrossProcess::ExeFromProcId(proc_info[j].kp_pid) : nullptr);
+    }
+    free(proc_info);
+  }
+  #endif
+  // rows by pid so lookups are a binary search, then the children index
+  std::size_t count = snapshot->ProcId.size();
+  std::vector<int> order(count);
+  for (std::size_t j = 0; j < count; j++) order[j] = (int)j;
+  std::sort(order.begin(), order.end(), [&](int a, int b) { 
+    return snapshot->ProcId[a] < snapshot->ProcId[b]; 
+  });
+  SNAPSHOT sorted;
+  for (std::size_t j = 0; j < count; j++) {
+    SnapshotAdd(&sorted, snapshot->ProcId[order[j]], snapshot->ParentProcId[order[j]],
+    snapshot->Exe.c_str() + snapshot->ExeOffset[order[j]]);
+  }
+  std::vector<int> byParent(count);
+  for (std::size_t j = 0; j < count; j++) byParent[j] = (int)j;
+  std::stable_sort(byParent.begin(), byParent.end(), [&](int a, int b) {
+    return sorted.ParentProcId[a] < sorted.ParentProcId[b];
+  });
+  for (std::size_t j = 0; j < count; j++) {
+    PROCID parent = sorted.ParentProcId[byParent[j]];
+    if (sorted.Parents.empty() || sorted.Parents.back() != parent) {
+      sorted.Parents.push_back(parent); sorted.ChildBegin.push_back((int)j);
+    }
+  }
+  sorted.ChildBegin.push_back((int)count);
+  sorted.Children.swap(byParent);
+  *snapshot = std::move(sorted);
+}
+
+int SnapshotRow(const SNAPSHOT *snapshot, PROCID procId) {
+  std::vector<PROCID>::const_iterator it = std::lower_bound(snapshot->ProcId.begin(), 
+  snapshot->ProcId.end(), procId);
+  if (it == snapshot->ProcId.end() || *it != procId) return -1;
+  return (int)(it - snapshot->ProcId.begin());
+}
+
+void SnapshotChildren(const SNAPSHOT *snapshot, PROCID parentProcId, std::vector<PROCID> *vec) {
+  std::vector<PROCID>::const_iterator it = std::lower_bound(snapshot->Parents.begin(), 
+  snapshot->Parents.end(), parentProcId);
+  if (it == snapshot->Parents.end() || *it != parentProcId) return;
+  std::size_t j = it - snapshot->Parents.begin();
+  for (int k = snapshot->ChildBegin[j]; k < snapshot->ChildBegin[j + 1]; k++) {
+    // init and the like can be listed as their own parent
+    PROCID child = snapshot->ProcId[snapshot->Children[k]];
+    if (child != parentProcId) vec->push_back(child);
+  }
+}
+
+/* processes being waited on: a pidfd each on Linux (-1 where the kernel
+is too old, those fall back to checking), a kqueue for all of them on
+the BSDs and macOS, a handle each on Windows */
+typedef struct {
+  std::vector<PROCID> ProcId;
+  #if defined(_WIN32)
+  std::vector<HANDLE> Handle;
+  #elif (defined(__linux__) && !defined(__ANDROID__))
+  std::vector<int> Fd;
+  #else
+  int Queue;
+  #endif
+} WATCHER;
+
+#if (defined(__linux__) && !defined(__ANDROID__))
+/* exited, or a zombie of ours: WNOWAIT leaves the reaping to whoever
+forked it, the way a pidfd becoming readable does */
+bool ProcExited(PROCID procId) {
+  siginfo_t info; info.si_pid = 0;
+  if (waitid(P_PID, procId, &info, WEXITED | WNOHANG | WNOWAIT) == 0) return info.si_pid == procId;
+  return kill(procId, 0) == -1 && errno == ESRCH;
+}
 #endif
 
+void ProcIdArray(const std::vector<PROCID> &vec, PROCID **procId, int *size) {
+  *procId = (PROCID *)malloc(sizeof(PROCID) * vec.size());
+  if (*procId) {
+    std::copy(vec.begin(), vec.end(), *procId);
+    *size = (int)vec.size();
+  }
+}
+
+/* the pointers and the strings they point at in one allocation, so the
+array owns what it refers to and outlives the call that made it */
+void StringArray(const std::vector<std::string> &vec, char ***buffer, int *size) {
+  std::size_t length = sizeof(char *) * (vec.size() + 1);
+  for (std::size_t j = 0; j < vec.size(); j++) length += vec[j].length() + 1;
+  char **arr = (char **)malloc(length);
+  if (arr == nullptr) return;
+  char *str = (char *)(arr + vec.size() + 1);
+  for (std::size_t j = 0; j < vec.size(); j++) {
+    memcpy(str, vec[j].c_str(), vec[j].length() + 1);
+    arr[j] = str; str += vec[j].length() + 1;
+  }
+  arr[vec.size()] = nullptr;
+  *buffer = arr; *size = (int)vec.size();
+}
+
+/* handles come from one counter and live in one of a few shards picked
+by their low bits, each shard with its own lock, so threads working on
+different handles seldom wait on each other; a handle itself is only
+ever used by one thread at a time */
+template <typename T>
+class HANDLES {
+ public:
+  int Insert(T *value) {
+    int handle = ++Index;
+    SHARD &shard = Shard[(unsigned)handle % SHARDS];
+    std::lock_guard<std::mutex> guard(shard.Mutex);
+    shard.Map[handle] = value;
+    return handle;
+  }
+  T *Find(int handle) {
+    SHARD &shard = Shard[(unsigned)handle % SHARDS];
+    std::lock_guard<std::mutex> guard(shard.Mutex);
+    typename std::unordered_map<int, T *>::iterator it = shard.Map.find(handle);
+    return (it != shard.Map.end()) ? it->second : nullptr;
+  }
+  T *Remove(int handle) {
+    SHARD &shard = Shard[(unsigned)handle % SHARDS];
+    std::lock_guard<std::mutex> guard(shard.Mutex);
+    typename std::unordered_map<int, T *>::iterator it = shard.Map.find(handle);
+    if (it == shard.Map.end()) return nullptr;
+    T *value = it->second; shard.Map.erase(it);
+    return value;
+  }
+ private:
+  static const unsigned SHARDS = 16;
+  typedef struct {
+    std::mutex Mutex;
+    std::unordered_map<int, T *> Map;
+  } SHARD;
+  std::atomic<int> Index { -1 };
+  SHARD Shard[SHARDS];
+};
+
 } // anonymous namespace
 
 namespace CrossProcess {
@@ -343,12 +670,7 @@ void ProcIdEnumerate(PROCID **procId, int *size) {
   }
   #elif (defined(__linux__) && !defined(__ANDROID__))
   if (ProcIdExists(0)) { vec.push_back(0); i++; }
-  PROCTAB *proc = openproc(PROC_FILLMEM | PROC_FILLSTAT | PROC_FILLSTATUS);
-  while (proc_t *proc_info = readproc(proc, nullptr)) {
-    vec.push_back(proc_info->tgid); i++;
-    freeproc(proc_info);
-  }
-  closeproc(proc);
+  ProcScan(&vec); i = (int)vec.size();
   #elif defined(__FreeBSD__)
   int cntp = 0; if (kinfo_proc *proc_info = kinfo_getallproc(&cntp)) {
     for (int j = 0; j < cntp; j++) {
@@ -474,12 +796,7 @@ void ParentProcIdFromProcId(PROCID procId, PROCID *parentProcId) {
     *parentProcId = proc_info.pbi_ppid;
   }
   #elif (defined(__linux__) && !defined(__ANDROID__))
-  PROCTAB *proc = openproc(PROC_FILLSTATUS | PROC_PID, &procId);
-  if (proc_t *proc_info = readproc(proc, nullptr)) { 
-    *parentProcId = proc_info->ppid;
-    freeproc(proc_info);
-  }
-  closeproc(proc);
+  ProcParent(procId, parentProcId);
   #elif defined(__FreeBSD__)
   if (kinfo_proc *proc_info = kinfo_getproc(procId)) {
     *parentProcId = proc_info->ki_ppid;
@@ -515,26 +832,16 @@ void ProcIdFromParentProcId(PROCID parentProcId, PROCID **procId, int *size) {
   }
   CloseHandle(hp);
   #elif (defined(__APPLE__) && defined(__MACH__))
-  int cntp = proc_listpids(PROC_ALL_PIDS, 0, nullptr, 0);
-  std::vector<PROCID> proc_info(cntp);
-  std::fill(proc_info.begin(), proc_info.end(), 0);
-  proc_listpids(PROC_ALL_PIDS, 0, &proc_info[0], sizeof(PROCID) * cntp);
-  for (int j = cntp - 1; j >= 0; j--) {
-    if (proc_info[j] == 0) { continue; }
-    PROCID ppid; ParentProcIdFromProcId(proc_info[j], &ppid);
-    if (ppid == parentProcId) {
-      vec.push_back(proc_info[j]); i++;
-    }
-  }
+  SNAPSHOT snapshot; SnapshotTake(&snapshot, false);
+  SnapshotChildren(&snapshot, parentProcId, &vec); i = (int)vec.size();
   #elif (defined(__linux__) && !defined(__ANDROID__))
-  PROCTAB *proc = openproc(PROC_FILLSTAT);
-  while (proc_t *proc_info = readproc(proc, nullptr)) {
-    if (proc_info->ppid == parentProcId) {
-      vec.push_back(proc_info->tgid); i++;
+  std::vector<PROCID> all; ProcScan(&all);
+  for (std::size_t j = 0; j < all.size(); j++) {
+    PROCID ppid = 0;
+    if (ProcParent(all[j], &ppid) && ppid == parentProcId) {
+      vec.push_back(all[j]); i++;
     }
-    freeproc(proc_info);
   }
-  closeproc(proc);
   #elif defined(__FreeBSD__)
   int cntp = 0; if (kinfo_proc *proc_info = kinfo_getallproc(&cntp)) {
     for (int j = 0; j < cntp; j++) {
@@ -573,7 +880,7 @@ void ExeFromProcId(PROCID procId, char **buffer) {
   if (procId == ProcIdFromSelf()) {
     wchar_t exe[MAX_PATH];
     if (GetModuleFileNameW(nullptr, exe, MAX_PATH) != 0) {
-      static std::string str; str = narrow(exe);
+      static thread_local std::string str; str = narrow(exe);
       *buffer = (char *)str.c_str();
     }
   } else {
@@ -581,7 +888,7 @@ void ExeFromProcId(PROCID procId, char **buffer) {
     if (proc == nullptr) return;
     wchar_t exe[MAX_PATH]; DWORD size = MAX_PATH;
     if (QueryFullProcessImageNameW(proc, 0, exe, &size) != 0) {
-      static std::string str; str = narrow(exe);
+      static thread_local std::string str; str = narrow(exe);
       *buffer = (char *)str.c_str();
     }
     CloseHandle(proc);
@@ -589,14 +896,14 @@ void ExeFromProcId(PROCID procId, char **buffer) {
   #elif (defined(__APPLE__) && defined(__MACH__))
   char exe[PROC_PIDPATHINFO_MAXSIZE];
   if (proc_pidpath(procId, exe, sizeof(exe)) > 0) {
-    static std::string str; str = exe;
+    static thread_local std::string str; str = exe;
     *buffer = (char *)str.c_str();
   }
   #elif (defined(__linux__) && !defined(__ANDROID__))
   char exe[PATH_MAX]; 
   std::string symLink = "/proc/" + std::to_string(procId) + "/exe";
   if (realpath(symLink.c_str(), exe)) {
-    static std::string str; str = exe;
+    static thread_local std::string str; str = exe;
     *buffer = (char *)str.c_str();
   }
   #elif defined(__FreeBSD__)
@@ -609,7 +916,7 @@ void ExeFromProcId(PROCID procId, char **buffer) {
     std::string str1; str1.resize(s, '\0');
     char *exe = str1.data();
     if (sysctl(mib, 4, exe, &s, nullptr, 0) == 0) {
-      static std::string str2; str2 = exe;
+      static thread_local std::string str2; str2 = exe;
       *buffer = (char *)str2.c_str();
     }
   }
@@ -624,7 +931,7 @@ void ExeFromProcId(PROCID procId, char **buffer) {
     std::string str1; str1.resize(s, '\0');
     char *exe = str1.data();
     if (sysctl(mib, 4, exe, &s, nullptr, 0) == 0) {
-      static std::string str2; str2 = exe;
+      static thread_local std::string str2; str2 = exe;
       *buffer = (char *)str2.c_str();
     }
   }
@@ -641,7 +948,7 @@ const char *ExecutableFromSelf() {
 }
 
 const char *DirectoryGetCurrentWorking() {
-  static std::string str;
+  static thread_local std::string str;
   #if defined(_WIN32)
   wchar_t u8dname[MAX_PATH];
   if (GetCurrentDirectoryW(MAX_PATH, u8dname) != 0) {
@@ -665,10 +972,27 @@ bool DirectorySetCurrentWorking(const char *dname) {
   #endif
 }
 
-static std::unordered_map<PROCESS, std::intptr_t> stdIptMap;
-static std::unordered_map<PROCESS, std::string>   stdOptMap;
-static std::unordered_map<PROCESS, bool>          completeMap;
-static std::mutex                                 stdOptMutex;
+/* a child's stdin, which closes with the last reference to it; a writer
+holds one across its write, under the entry's own lock so two writes
+don't interleave, while stdIptMutex only guards the map, so dropping a
+process from it never waits on a child that isn't reading */
+typedef struct {
+  std::intptr_t File;
+  std::mutex Mutex;
+} STDINPUT;
+
+static std::unordered_map<PROCESS, std::shared_ptr<STDINPUT> > stdIptMap;
+static std::unordered_map<PROCESS, std::string>               stdOptMap;
+static std::unordered_map<PROCESS, bool>                      completeMap;
+static std::mutex                                             stdIptMutex;
+static std::mutex                                             stdOptMutex;
+
+/* a copy, since the reactor may be appending to the original */
+static inline std::string OutputCopy(PROCESS procIndex) {
+  std::lock_guard<std::mutex> guard(stdOptMutex);
+  std::unordered_map<PROCESS, std::string>::iterator it = stdOptMap.find(procIndex);
+  return (it != stdOptMap.end()) ? it->second : std::string();
+}
 
 void CwdFromProcId(PROCID procId, char **buffer) {
   *buffer = nullptr;
@@ -699,7 +1023,7 @@ void CwdFromProcId(PROCID procId, char **buffer) {
       }
     }
     PROCESS ind = ProcessExecute(("\"" + exe + "\" --cwd-from-pid " + std::to_string(procId)).c_str());
-    static std::string str; if (stdOptMap.find(ind) != stdOptMap.end()) str = stdOptMap.find(ind)->second;
+    static thread_local std::string str; str = OutputCopy(ind);
     *buffer = (char *)str.c_str();
     FreeExecutedProcessStandardOutput(ind);
   } else {
@@ -707,7 +1031,7 @@ void CwdFromProcId(PROCID procId, char **buffer) {
     wchar_t *cwdbuf = nullptr;
     CwdCmdEnvFromProc(proc, &cwdbuf, MEMCWD);
     if (cwdbuf) {
-      static std::string str; str = narrow(cwdbuf);
+      static thread_local std::string str; str = narrow(cwdbuf);
       *buffer = (char *)str.c_str();
       delete[] cwdbuf;
     }
@@ -720,14 +1044,14 @@ void CwdFromProcId(PROCID procId, char **buffer) {
   char cwd[PROC_PIDPATHINFO_MAXSIZE];
   if (proc_pidinfo(procId, PROC_PIDVNODEPATHINFO, 0, &vpi, sizeof(vpi)) > 0) {
     strcpy(cwd, vpi.pvi_cdir.vip_path);
-    static std::string str; str = cwd;
+    static thread_local std::string str; str = cwd;
     *buffer = (char *)str.c_str();
   }
   #elif (defined(__linux__) && !defined(__ANDROID__))
   char cwd[PATH_MAX];
   std::string symLink = "/proc/" + std::to_string(procId) + "/cwd";
   if (realpath(symLink.c_str(), cwd)) {
-    static std::string str; str = cwd;
+    static thread_local std::string str; str = cwd;
     *buffer = (char *)str.c_str();
   }
   #elif defined(__FreeBSD__)
@@ -742,7 +1066,7 @@ void CwdFromProcId(PROCID procId, char **buffer) {
         STAILQ_FOREACH(fst, head, next) {
           if (fst->fs_uflags & PS_FST_UFLAG_CDIR) {
             strcpy(cwd, fst->fs_path);
-            static std::string str; str = cwd;
+            static thread_local std::string str; str = cwd;
             *buffer = (char *)str.c_str();
           }
         }
@@ -762,7 +1086,7 @@ void CwdFromProcId(PROCID procId, char **buffer) {
     std::vector<char> str1; str1.resize(s, '\0');
     char *cwd = str1.data();
     if (sysctl(mib, 4, cwd, &s, nullptr, 0) == 0) {
-      static std::string str2; str2 = cwd ? : "";
+      static thread_local std::string str2; str2 = cwd ? : "";
       *buffer = (char *)str2.c_str();
     }
   }
@@ -775,15 +1099,12 @@ const char *CwdFromProcId(PROCID procId) {
 }
 
 void FreeCmdline(char **buffer) {
-  if (buffer) {
-    delete[] buffer;
-  }
+  free(buffer);
 }
 
-static std::vector<std::string> CmdlineVec1;
 void CmdlineFromProcId(PROCID procId, char ***buffer, int *size) {
   *buffer = nullptr; *size = 0;
-  CmdlineVec1.clear(); int i = 0;
+  std::vector<std::string> CmdlineVec1;
   if (!ProcIdExists(procId)) return;
   #if defined(_WIN32)
   HANDLE proc = OpenProcessWithDebugPrivilege(procId);
@@ -811,11 +1132,11 @@ void CmdlineFromProcId(PROCID procId, char ***buffer, int *size) {
       }
     }
     PROCESS ind = ProcessExecute(("\"" + exe + "\" --cmd-from-pid " + std::to_string(procId)).c_str());
-    std::string str;  if (stdOptMap.find(ind) != stdOptMap.end()) str = stdOptMap.find(ind)->second;
+    std::string str = OutputCopy(ind);
     char *cmd = str.data();
     int j = 0; if (!str.empty()) {
       while (cmd[j] != '\0') {
-        CmdlineVec1.push_back(&cmd[j]); i++;
+        CmdlineVec1.push_back(&cmd[j]);
         j += strlen(cmd + j) + 1;
       }
     }
@@ -827,8 +1148,8 @@ void CmdlineFromProcId(PROCID procId, char ***buffer, int *size) {
     if (cmdbuf) {
       wchar_t **cmdline = CommandLineToArgvW(cmdbuf, &cmdsize);
       if (cmdline) {
-        while (i < cmdsize) {
-          CmdlineVec1.push_back(narrow(cmdline[i])); i++;
+        for (int i = 0; i < cmdsize; i++) {
+          CmdlineVec1.push_back(narrow(cmdline[i]));
         }
         LocalFree(cmdline);
       }
@@ -839,25 +1160,9 @@ void CmdlineFromProcId(PROCID procId, char ***buffer, int *size) {
   #endif
   CloseHandle(proc);
   #elif (defined(__APPLE__) && defined(__MACH__))
-  char **cmdline = nullptr; int cmdsiz = 0;
-  CmdEnvFromProcId(procId, &cmdline, &cmdsiz, MEMCMD);
-  if (cmdline) {
-    for (int j = 0; j < cmdsiz; j++) {
-      CmdlineVec1.push_back(cmdline[i]); i++;
-    }
-    delete[] cmdline;
-  }
+  CmdEnvFromProcId(procId, &CmdlineVec1, MEMCMD);
   #elif (defined(__linux__) && !defined(__ANDROID__))
-  PROCTAB *proc = openproc(PROC_FILLCOM | PROC_PID, &procId);
-  if (proc_t *proc_info = readproc(proc, nullptr)) {
-    if (proc_info->cmdline) {
-      for (int j = 0; proc_info->cmdline[j]; j++) {
-        CmdlineVec1.push_back(proc_info->cmdline[j]); i++;
-      }
-    }
-    freeproc(proc_info);
-  }
-  closeproc(proc);
+  ProcStrings(procId, "cmdline", &CmdlineVec1);
   #elif defined(__FreeBSD__)
   procstat *proc_stat = procstat_open_sysctl(); unsigned cntp = 0;
   if (proc_stat) {
@@ -866,7 +1171,7 @@ void CmdlineFromProcId(PROCID procId, char ***buffer, int *size) {
       char **cmdline = procstat_getargv(proc_stat, proc_info, 0);
       if (cmdline) {
         for (int j = 0; cmdline[j]; j++) {
-          CmdlineVec1.push_back(cmdline[j]); i++;
+          CmdlineVec1.push_back(cmdline[j]);
         }
         procstat_freeargv(proc_stat);
       }
@@ -883,22 +1188,17 @@ void CmdlineFromProcId(PROCID procId, char ***buffer, int *size) {
     char **cmdline = kvm_getargv(kd, proc_info, 0);
     if (cmdline) {
       for (int j = 0; cmdline[j]; j++) {
-        CmdlineVec1.push_back(cmdline[j]); i++;
+        CmdlineVec1.push_back(cmdline[j]);
       }
     }
     free(proc_info);
   }
   #endif
-  std::vector<char *> CmdlineVec2;
-  for (int i = 0; i < CmdlineVec1.size(); i++)
-    CmdlineVec2.push_back((char *)CmdlineVec1[i].c_str());
-  char **arr = new char *[CmdlineVec2.size()]();
-  std::copy(CmdlineVec2.begin(), CmdlineVec2.end(), arr);
-  *buffer = arr; *size = i;
+  StringArray(CmdlineVec1, buffer, size);
 }
 
 const char *EnvironmentGetVariable(const char *name) {
-  static std::string str;
+  static thread_local std::string str;
   #if defined(_WIN32)
   wchar_t buffer[32767];
   std::wstring u8name = widen(name);
@@ -932,15 +1232,12 @@ bool EnvironmentUnsetVariable(const char *name) {
 }
 
 void FreeEnviron(char **buffer) {
-  if (buffer) {
-    delete[] buffer;
-  }
+  free(buffer);
 }
 
-static std::vector<std::string> EnvironVec1; 
 void EnvironFromProcId(PROCID procId, char ***buffer, int *size) {
   *buffer = nullptr; *size = 0;
-  EnvironVec1.clear(); int i = 0;
+  std::vector<std::string> EnvironVec1;
   if (!ProcIdExists(procId)) return;
   #if defined(_WIN32)
   HANDLE proc = OpenProcessWithDebugPrivilege(procId);
@@ -968,11 +1265,11 @@ void EnvironFromProcId(PROCID procId, char ***buffer, int *size) {
       }
     }
     PROCESS ind = ProcessExecute(("\"" + exe + "\" --env-from-pid " + std::to_string(procId)).c_str());
-    std::string str; if (stdOptMap.find(ind) != stdOptMap.end()) str = stdOptMap.find(ind)->second;
+    std::string str = OutputCopy(ind);
     char *env = str.data();
     int j = 0; if (!str.empty()) {
       while (env[j] != '\0') {
-        EnvironVec1.push_back(&env[j]); i++;
+        EnvironVec1.push_back(&env[j]);
         j += strlen(env + j) + 1;
       }
     }
@@ -983,7 +1280,7 @@ void EnvironFromProcId(PROCID procId, char ***buffer, int *size) {
     CwdCmdEnvFromProc(proc, &wenv, MEMENV);
     int j = 0; if (wenv) {
       while (wenv[j] != L'\0') {
-        EnvironVec1.push_back(narrow(&wenv[j])); i++;
+        EnvironVec1.push_back(narrow(&wenv[j]));
         j += wcslen(wenv + j) + 1;
       }
       delete[] wenv;
@@ -993,25 +1290,9 @@ void EnvironFromProcId(PROCID procId, char ***buffer, int *size) {
   #endif
   CloseHandle(proc);
   #elif (defined(__APPLE__) && defined(__MACH__))
-  char **env = nullptr; int envsiz = 0;
-  CmdEnvFromProcId(procId, &env, &envsiz, MEMENV);
-  if (env) {
-    for (int j = 0; j < envsiz; j++) {
-      EnvironVec1.push_back(env[i]); i++;
-    }
-    delete[] env;
-  }
+  CmdEnvFromProcId(procId, &EnvironVec1, MEMENV);
   #elif (defined(__linux__) && !defined(__ANDROID__))
-  PROCTAB *proc = openproc(PROC_FILLENV | PROC_PID, &procId);
-  if (proc_t *proc_info = readproc(proc, nullptr)) {
-    if (proc_info->environ) {
-      for (int j = 0; proc_info->environ[j]; j++) {
-        EnvironVec1.push_back(proc_info->environ[j]); i++;
-      }
-    }
-    freeproc(proc_info);
-  }
-  closeproc(proc);
+  ProcStrings(procId, "environ", &EnvironVec1);
   #elif defined(__FreeBSD__)
   procstat *proc_stat = procstat_open_sysctl(); unsigned cntp = 0;
   if (proc_stat) {
@@ -1020,7 +1301,7 @@ void EnvironFromProcId(PROCID procId, char ***buffer, int *size) {
       char **env = procstat_getenvv(proc_stat, proc_info, 0);
       if (env) {
         for (int j = 0; env[j]; j++) {
-          EnvironVec1.push_back(env[j]); i++;
+          EnvironVec1.push_back(env[j]);
         }
         procstat_freeenvv(proc_stat);
       }
@@ -1037,18 +1318,13 @@ void EnvironFromProcId(PROCID procId, char ***buffer, int *size) {
     char **environ = kvm_getenvv(kd, proc_info, 0);
     if (environ) {
       for (int j = 0; environ[j]; j++) {
-        EnvironVec1.push_back(environ[j]); i++;
+        EnvironVec1.push_back(environ[j]);
       }
     }
     free(proc_info);
   }
   #endif
-  std::vector<char *> EnvironVec2;
-  for (int i = 0; i < EnvironVec1.size(); i++)
-    EnvironVec2.push_back((char *)EnvironVec1[i].c_str());
-  char **arr = new char *[EnvironVec2.size()]();
-  std::copy(EnvironVec2.begin(), EnvironVec2.end(), arr);
-  *buffer = arr; *size = i;
+  StringArray(EnvironVec1, buffer, size);
 }
 
 void EnvironFromProcIdEx(PROCID procId, const char *name, char **value) {
@@ -1062,7 +1338,7 @@ void EnvironFromProcIdEx(PROCID procId, const char *name, char **value) {
         std::transform(equalssplit[0].begin(), equalssplit[0].end(), equalssplit[0].begin(), ::toupper);
         std::transform(str1.begin(), str1.end(), str1.begin(), ::toupper);
         if (j == equalssplit.size() - 1 && equalssplit[0] == str1) {
-          static std::string str2; str2 = equalssplit[j];
+          static thread_local std::string str2; str2 = equalssplit[j];
           *value = (char *)str2.c_str();
         }
       }
@@ -1073,22 +1349,191 @@ void EnvironFromProcIdEx(PROCID procId, const char *name, char **value) {
 
 #if defined(XPROCESS_GUIWINDOW_IMPL)
 #if (defined(__linux__) && !defined(__ANDROID__)) || (defined(__FreeBSD__) || defined(__DragonFly__)) || defined(XPROCESS_XQUARTZ_IMPL)
-static inline int XErrorHandlerImpl(Display *display, XErrorEvent *event) {
-  return 0;
+/* every client window's pid, kept between calls on one connection that
+listens for PropertyNotify on the root; the client list is read again
+only after it changes, and only windows new to it are asked for their
+_NET_WM_PID, so a lookup with no change in between is no round trip;
+the connection is Xlib, or XCB when built with XPROCESS_XCB_IMPL */
+typedef struct {
+  #if defined(XPROCESS_XCB_IMPL)
+  xcb_connection_t *Connection;
+  xcb_window_t Root;
+  xcb_atom_t ClientList;
+  xcb_atom_t WmPid;
+  #else
+  Display *Connection;
+  Atom ClientList;
+  Atom WmPid;
+  #endif
+  bool Stale;
+  std::vector<WINDOW> Stacking;                  // bottom first, as the property has it
+  std::unordered_map<WINDOW, PROCID> ProcIdOf;
+} WINDOWINDEX;
+
+static std::mutex windowIndexMutex;
+static WINDOWINDEX windowIndex;
+
+#if defined(XPROCESS_XCB_IMPL)
+/* connects if need be and takes the events waiting, false if there's no
+display; unlike Xlib a lost connection doesn't end the process, the
+next call simply connects again */
+static bool WindowIndexConnect() {
+  if (windowIndex.Connection && xcb_connection_has_error(windowIndex.Connection)) {
+    xcb_disconnect(windowIndex.Connection); windowIndex.Connection = nullptr;
+    windowIndex.Stacking.clear(); windowIndex.ProcIdOf.clear();
+  }
+  if (windowIndex.Connection == nullptr) {
+    int screen = 0; xcb_connection_t *connection = xcb_connect(nullptr, &screen);
+    if (xcb_connection_has_error(connection)) { xcb_disconnect(connection); return false; }
+    xcb_screen_iterator_t it = xcb_setup_roots_iterator(xcb_get_setup(connection));
+    for (; it.rem && screen > 0; screen--) xcb_screen_next(&it);
+    if (!it.rem) { xcb_disconnect(connection); return false; }
+    windowIndex.Root = it.data->root;
+    // both atoms asked for before either answer is waited on
+    const char *clientList = "_NET_CLIENT_LIST_STACKING", *wmPid = "_NET_WM_PID";
+    xcb_intern_atom_cookie_t clientListCookie = xcb_intern_atom(connection, false, strlen(clientList), clientList);
+    xcb_intern_atom_cookie_t wmPidCookie = xcb_intern_atom(connection, false, strlen(wmPid), wmPid);
+    xcb_intern_atom_reply_t *reply = xcb_intern_atom_reply(connection, clientListCookie, nullptr);
+    windowIndex.ClientList = reply ? reply->atom : XCB_ATOM_NONE; free(reply);
+    reply = xcb_intern_atom_reply(connection, wmPidCookie, nullptr);
+    windowIndex.WmPid = reply ? reply->atom : XCB_ATOM_NONE; free(reply);
+    std::uint32_t mask = XCB_EVENT_MASK_PROPERTY_CHANGE;
+    xcb_change_window_attributes(connection, windowIndex.Root, XCB_CW_EVENT_MASK, &mask);
+    xcb_flush(connection);
+    windowIndex.Connection = connection; windowIndex.Stale = true;
+  }
+  xcb_generic_event_t *event = nullptr;
+  while ((event = xcb_poll_for_event(windowIndex.Connection))) {
+    if ((event->response_type & ~0x80) == XCB_PROPERTY_NOTIFY && 
+      ((xcb_property_notify_event_t *)event)->atom == windowIndex.ClientList)
+      windowIndex.Stale = true;
+    free(event);
+  }
+  return true;
+}
+
+static void WindowIndexClientList(std::vector<WINDOW> *stacking) {
+  xcb_get_property_cookie_t cookie = xcb_get_property(windowIndex.Connection, false, windowIndex.Root, 
+  windowIndex.ClientList, XCB_GET_PROPERTY_TYPE_ANY, 0, 1024);
+  xcb_get_property_reply_t *reply = xcb_get_property_reply(windowIndex.Connection, cookie, nullptr);
+  if (reply && reply->format == 32) {
+    xcb_window_t *array = (xcb_window_t *)xcb_get_property_value(reply);
+    stacking->assign(array, array + xcb_get_property_value_length(reply) / 4);
+  }
+  free(reply);
+}
+
+/* every request is sent before any reply is waited on, so however many
+windows there are it costs one round trip */
+static void WindowIndexProcIds(const std::vector<WINDOW> &windows, std::vector<PROCID> *pids) {
+  std::vector<xcb_get_property_cookie_t> cookies(windows.size());
+  for (std::size_t j = 0; j < windows.size(); j++)
+    cookies[j] = xcb_get_property(windowIndex.Connection, false, windows[j], 
+    windowIndex.WmPid, XCB_ATOM_CARDINAL, 0, 1);
+  for (std::size_t j = 0; j < windows.size(); j++) {
+    xcb_generic_error_t *error = nullptr; PROCID pid = 0;
+    xcb_get_property_reply_t *reply = xcb_get_property_reply(windowIndex.Connection, cookies[j], &error);
+    if (reply && reply->format == 32 && xcb_get_property_value_length(reply) >= 4)
+      pid = (PROCID)*(std::uint32_t *)xcb_get_property_value(reply);
+    free(reply); free(error);
+    pids->push_back(pid);
+  }
 }
+#else
+static XErrorHandler windowIndexErrorHandler = nullptr;
+
+/* errors on our connection are expected, a window can go away between
+reading the client list and asking it for its pid; anything else is the
+caller's and goes to the handler it had installed */
+static int WindowIndexXError(Display *display, XErrorEvent *event) {
+  if (display == windowIndex.Connection) return 0;
+  return windowIndexErrorHandler ? windowIndexErrorHandler(display, event) : 0;
+}
+
+/* Xlib's error handler is process wide, so ours is only in place while
+one of the functions below is talking to the server, and the caller's
+is put back after */
+class XERRORSCOPE {
+ public:
+  XERRORSCOPE() { windowIndexErrorHandler = XSetErrorHandler(WindowIndexXError); }
+  ~XERRORSCOPE() { XSetErrorHandler(windowIndexErrorHandler); }
+};
 
-static inline int XIOErrorHandlerImpl(Display *display) {
-  return 0;
+/* connects if need be and takes the events waiting, false if there's no display */
+static bool WindowIndexConnect() {
+  XERRORSCOPE scope;
+  if (windowIndex.Connection == nullptr) {
+    windowIndex.Connection = XOpenDisplay(nullptr);
+    if (windowIndex.Connection == nullptr) return false;
+    windowIndex.ClientList = XInternAtom(windowIndex.Connection, "_NET_CLIENT_LIST_STACKING", false);
+    windowIndex.WmPid = XInternAtom(windowIndex.Connection, "_NET_WM_PID", false);
+    XSelectInput(windowIndex.Connection, XDefaultRootWindow(windowIndex.Connection), PropertyChangeMask);
+    // so an error from XSelectInput() arrives while our handler is in place
+    XSync(windowIndex.Connection, false);
+    windowIndex.Stale = true;
+  }
+  while (XPending(windowIndex.Connection)) {
+    XEvent event; XNextEvent(windowIndex.Connection, &event);
+    if (event.type == PropertyNotify && event.xproperty.atom == windowIndex.ClientList)
+      windowIndex.Stale = true;
+  }
+  return true;
+}
+
+static void WindowIndexClientList(std::vector<WINDOW> *stacking) {
+  XERRORSCOPE scope;
+  unsigned char *prop = nullptr;
+  Atom actual_type = 0; int actual_format = 0;
+  unsigned long nitems = 0, bytes_after = 0;
+  int status = XGetWindowProperty(windowIndex.Connection, XDefaultRootWindow(windowIndex.Connection), 
+  windowIndex.ClientList, 0, 1024, false, AnyPropertyType, &actual_type, &actual_format, 
+  &nitems, &bytes_after, &prop);
+  if (status == Success && prop != nullptr && actual_format == 32) {
+    unsigned long *array = (unsigned long *)prop;
+    stacking->assign(array, array + nitems);
+  }
+  if (prop) XFree(prop);
+}
+
+/* a round trip for each window, Xlib has no way to have several out at once */
+static void WindowIndexProcIds(const std::vector<WINDOW> &windows, std::vector<PROCID> *pids) {
+  XERRORSCOPE scope;
+  for (std::size_t j = 0; j < windows.size(); j++) {
+    unsigned char *prop = nullptr; PROCID pid = 0;
+    Atom actual_type = 0; int actual_format = 0;
+    unsigned long nitems = 0, bytes_after = 0;
+    int status = XGetWindowProperty(windowIndex.Connection, windows[j], windowIndex.WmPid, 0, 1000, false,
+    AnyPropertyType, &actual_type, &actual_format, &nitems, &bytes_after, &prop);
+    if (status == Success && prop != nullptr) {
+      if (nitems) pid = (PROCID)(prop[0] + (prop[1] << 8) + (prop[2] << 16) + (prop[3] << 24));
+      XFree(prop);
+    }
+    pids->push_back(pid);
+  }
 }
+#endif
 
-static inline void SetErrorHandlers() {
-  XSetErrorHandler(XErrorHandlerImpl);
-  XSetIOErrorHandler(XIOErrorHandlerImpl);
+/* brings the index up to date, false if there's no display; called with
+windowIndexMutex held, which is also what serializes the connection */
+static bool WindowIndexRefresh() {
+  if (!WindowIndexConnect()) return false;
+  if (!windowIndex.Stale) return true;
+  std::vector<WINDOW> stacking, fresh; WindowIndexClientList(&stacking);
+  for (std::size_t j = 0; j < stacking.size(); j++)
+    if (windowIndex.ProcIdOf.find(stacking[j]) == windowIndex.ProcIdOf.end()) fresh.push_back(stacking[j]);
+  std::vector<PROCID> pids; WindowIndexProcIds(fresh, &pids);
+  std::unordered_map<WINDOW, PROCID> procIdOf;
+  for (std::size_t j = 0; j < fresh.size(); j++) procIdOf[fresh[j]] = pids[j];
+  for (std::size_t j = 0; j < stacking.size(); j++)
+    if (procIdOf.find(stacking[j]) == procIdOf.end()) procIdOf[stacking[j]] = windowIndex.ProcIdOf[stacking[j]];
+  windowIndex.Stacking.swap(stacking); windowIndex.ProcIdOf.swap(procIdOf);
+  windowIndex.Stale = false;
+  return true;
 }
 #endif
 
 WINDOWID WindowIdFromNativeWindow(WINDOW window) {
-  static std::string res; 
+  static thread_local std::string res; 
   res = std::to_string((unsigned long long)window);
   return (WINDOWID)res.c_str();
 }
@@ -1097,21 +1542,15 @@ WINDOW NativeWindowFromWindowId(WINDOWID winId) {
   return (WINDOW)strtoull(winId, nullptr, 10);
 }
 
-static std::vector<std::string> widVec1;
-void WindowIdFromProcId(PROCID procId, WINDOWID **winId, int *size) {
-  *winId = nullptr; *size = 0;
-  widVec1.clear(); int i = 0;
-  if (!ProcIdExists(procId)) return;
+/* every top level window with the process that owns it, in stacking
+order from the top; a procId other than 0 keeps only that process' */
+static void WindowIdScan(PROCID procId, std::vector<PROCID> *pidVec, std::vector<std::string> *widVec) {
   #if defined(_WIN32)
-  HWND hWnd = GetTopWindow(GetDesktopWindow());
-  PROCID pid = 0; ProcIdFromWindowId(WindowIdFromNativeWindow(hWnd), &pid);
-  if (procId == pid) {  
-    widVec1.push_back(WindowIdFromNativeWindow(hWnd)); i++; 
-  }
-  while (hWnd = GetWindow(hWnd, GW_HWNDNEXT)) {
-    PROCID pid = 0; ProcIdFromWindowId(WindowIdFromNativeWindow(hWnd), &pid);
-    if (procId == pid) {  
-      widVec1.push_back(WindowIdFromNativeWindow(hWnd)); i++; 
+  for (HWND hWnd = GetTopWindow(GetDesktopWindow()); hWnd; hWnd = GetWindow(hWnd, GW_HWNDNEXT)) {
+    DWORD pid = 0; GetWindowThreadProcessId(hWnd, &pid);
+    if (procId == 0 || procId == (PROCID)pid) {  
+      pidVec->push_back((PROCID)pid);
+      widVec->push_back(WindowIdFromNativeWindow(hWnd));
     }
   }
   #elif (defined(__APPLE__) && defined(__MACH__)) && !defined(XPROCESS_XQUARTZ_IMPL)
@@ -1125,79 +1564,47 @@ void WindowIdFromProcId(PROCID procId, WINDOWID **winId, int *size) {
       CFNumberRef ownerPID = (CFNumberRef)CFDictionaryGetValue(
       windowInfoDictionary, kCGWindowOwnerPID); PROCID pid = 0;
       CFNumberGetValue(ownerPID, kCFNumberIntType, &pid);
-      if (procId == pid) {
+      if (procId == 0 || procId == pid) {
         CFNumberRef windowID = (CFNumberRef)CFDictionaryGetValue(
         windowInfoDictionary, kCGWindowNumber);
         CGWindowID wid; CFNumberGetValue(windowID,
         kCGWindowIDCFNumberType, &wid);
-        widVec1.push_back(WindowIdFromNativeWindow(wid)); i++;
+        pidVec->push_back(pid);
+        widVec->push_back(WindowIdFromNativeWindow(wid));
       }
     }
   }
   CFRelease(windowArray);
   #elif (defined(__linux__) && !defined(__ANDROID__)) || (defined(__FreeBSD__) || defined(__DragonFly__)) || defined(XPROCESS_XQUARTZ_IMPL)
-  SetErrorHandlers();
-  Display *display = XOpenDisplay(nullptr);
-  Window window = XDefaultRootWindow(display);
-  unsigned char *prop = nullptr;
-  Atom actual_type = 0, filter_atom = 0;
-  int actual_format = 0, status = 0;
-  unsigned long nitems = 0, bytes_after = 0;
-  filter_atom = XInternAtom(display, "_NET_CLIENT_LIST_STACKING", true);
-  status = XGetWindowProperty(display, window, filter_atom, 0, 1024, false,
-  AnyPropertyType, &actual_type, &actual_format, &nitems, &bytes_after, &prop);
-  if (status == Success && prop != nullptr && nitems) {
-    if (actual_format == 32) {
-      unsigned long *array = (unsigned long *)prop;
-      for (int j = nitems - 1; j >= 0; j--) {
-        PROCID pid; ProcIdFromWindowId(WindowIdFromNativeWindow(array[j]), &pid);
-        if (procId == pid) {
-          widVec1.push_back(WindowIdFromNativeWindow(array[j])); i++;
-        }
-      }
+  std::lock_guard<std::mutex> guard(windowIndexMutex);
+  if (!WindowIndexRefresh()) return;
+  for (std::size_t j = windowIndex.Stacking.size(); j-- > 0;) {
+    PROCID pid = windowIndex.ProcIdOf[windowIndex.Stacking[j]];
+    if (pid && (procId == 0 || procId == pid)) {
+      pidVec->push_back(pid);
+      widVec->push_back(WindowIdFromNativeWindow(windowIndex.Stacking[j]));
     }
-    XFree(prop);
   }
-  XCloseDisplay(display);
   #endif
-  std::vector<WINDOWID> widVec2;
-  for (int i = 0; i < widVec1.size(); i++)
-    widVec2.push_back((WINDOWID)widVec1[i].c_str());
-  WINDOWID *arr = new WINDOWID[widVec2.size()]();
-  std::copy(widVec2.begin(), widVec2.end(), arr);
-  *winId = arr; *size = i;
+}
+
+void WindowIdFromProcId(PROCID procId, WINDOWID **winId, int *size) {
+  *winId = nullptr; *size = 0;
+  std::vector<PROCID> pidVec1; std::vector<std::string> widVec1;
+  if (!ProcIdExists(procId)) return;
+  WindowIdScan(procId, &pidVec1, &widVec1);
+  StringArray(widVec1, winId, size);
 }
 
 void FreeWindowId(WINDOWID *winId) {
-  if (winId) {
-    delete[] winId;
-  }
+  free(winId);
 }
 
-static std::vector<std::string> widVec3;
 void WindowIdEnumerate(WINDOWID **winId, int *size) {
   *winId = nullptr; *size = 0;
-  widVec3.clear(); int i = 0;
-  PROCID *pid = nullptr; int pidsize = 0; 
-  ProcIdEnumerate(&pid, &pidsize);
-  if (pid) {
-    for (int j = 0; j < pidsize; j++) {
-      WINDOWID *wid = nullptr; int widsize = 0;
-      WindowIdFromProcId(pid[j], &wid, &widsize);
-      if (wid) {
-        for (int ii = 0; ii < widsize; ii++) {
-          widVec3.push_back(wid[ii]); i++;
-        }
-        FreeWindowId(wid);
-      }
-    }
-  }
-  std::vector<WINDOWID> widVec4;
-  for (int i = 0; i < widVec3.size(); i++)
-    widVec4.push_back((WINDOWID)widVec3[i].c_str());
-  WINDOWID *arr = new WINDOWID[widVec4.size()]();
-  std::copy(widVec4.begin(), widVec4.end(), arr);
-  *winId = arr; *size = i;
+  std::vector<PROCID> pidVec3; std::vector<std::string> widVec3;
+  WindowIdScan(0, &pidVec3, &widVec3);
+  StringArray(widVec3, winId, size);
 }
 
 void ProcIdFromWindowId(WINDOWID winId, PROCID *procId) {
@@ -1206,47 +1613,22 @@ void ProcIdFromWindowId(WINDOWID winId, PROCID *procId) {
   DWORD pid = 0; GetWindowThreadProcessId(NativeWindowFromWindowId(winId), &pid);
   *procId = (PROCID)pid;
   #elif (defined(__APPLE__) && defined(__MACH__)) && !defined(XPROCESS_XQUARTZ_IMPL)
-  CFArrayRef windowArray = CGWindowListCopyWindowInfo(
-  kCGWindowListOptionAll, kCGNullWindowID);
-  CFIndex windowCount = 0;
-  if ((windowCount = CFArrayGetCount(windowArray))) {
-    for (CFIndex i = 0; i < windowCount; i++) {
-      CFDictionaryRef windowInfoDictionary = 
-      (CFDictionaryRef)CFArrayGetValueAtIndex(windowArray, i);
-      CFNumberRef ownerPID = (CFNumberRef)CFDictionaryGetValue(
-      windowInfoDictionary, kCGWindowOwnerPID); PROCID pid = 0;
-      CFNumberGetValue(ownerPID, kCFNumberIntType, &pid);
-      WINDOWID *wid = nullptr; int size = 0; 
-      WindowIdFromProcId(pid, &wid, &size);
-      if (wid) {
-        for (int j = 0; j < size; j++) {
-          if (strtoul(winId, nullptr, 10) == strtoul(wid[j], nullptr, 10)) {
-            *procId = pid;
-            break;
-          }
-        }
-        FreeWindowId(wid);
-      }      
+  std::vector<PROCID> pidVec; std::vector<std::string> widVec;
+  WindowIdScan(0, &pidVec, &widVec);
+  for (std::size_t j = 0; j < widVec.size(); j++) {
+    if (strtoul(winId, nullptr, 10) == strtoul(widVec[j].c_str(), nullptr, 10)) {
+      *procId = pidVec[j];
+      break;
     }
   }
-  CFRelease(windowArray);
   #elif (defined(__linux__) && !defined(__ANDROID__)) || (defined(__FreeBSD__) || defined(__DragonFly__)) || defined(XPROCESS_XQUARTZ_IMPL)
-  SetErrorHandlers();
-  Display *display = XOpenDisplay(nullptr);
-  unsigned long property = 0;
-  unsigned char *prop = nullptr;
-  Atom actual_type = 0, filter_atom = 0;
-  int actual_format = 0, status = 0;
-  unsigned long nitems = 0, bytes_after = 0;
-  filter_atom = XInternAtom(display, "_NET_WM_PID", true);
-  status = XGetWindowProperty(display, NativeWindowFromWindowId(winId), filter_atom, 0, 1000, false,
-  AnyPropertyType, &actual_type, &actual_format, &nitems, &bytes_after, &prop);
-  if (status == Success && prop != nullptr) {
-    property = prop[0] + (prop[1] << 8) + (prop[2] << 16) + (prop[3] << 24);
-    XFree(prop);
-  }
-  *procId = (PROCID)property;
-  XCloseDisplay(display);
+  // a window that isn't a client (so not in the index) is asked directly
+  std::lock_guard<std::mutex> guard(windowIndexMutex);
+  if (!WindowIndexRefresh()) return;
+  WINDOW window = NativeWindowFromWindowId(winId);
+  std::unordered_map<WINDOW, PROCID>::iterator it = windowIndex.ProcIdOf.find(window);
+  if (it != windowIndex.ProcIdOf.end()) *procId = it->second;
+  else { std::vector<PROCID> pids; WindowIndexProcIds(std::vector<WINDOW>(1, window), &pids); *procId = pids[0]; }
   #endif
   if (!ProcIdExists(*procId)) {
     *procId = 0;
@@ -1272,133 +1654,451 @@ bool WindowIdKill(WINDOWID winId) {
 }
 #endif
 
-static int procInfoIndex = -1;
-static int procListIndex = -1;
-static std::unordered_map<PROCINFO, _PROCINFO *> procInfoMap;
-static std::vector<std::vector<PROCID>>          procListVec;
-
-PROCINFO ProcInfoFromProcId(PROCID procId) {
-  char *exe    = nullptr; ExeFromProcId(procId, &exe);
-  char *cwd    = nullptr; CwdFromProcId(procId, &cwd);
-  PROCID ppid  = 0; ParentProcIdFromProcId(procId, &ppid);
-  PROCID *pid  = nullptr; int pidsize = 0; 
-  ProcIdFromParentProcId(procId, &pid, &pidsize);
-  char **cmd   = nullptr; int cmdsize = 0; 
-  CmdlineFromProcId(procId, &cmd, &cmdsize);
-  char **env   = nullptr; int envsize = 0; 
-  EnvironFromProcId(procId, &env, &envsize);
+/* the info is only a pid until a field is asked for, each field is read
+once, the first time, and kept; Loaded has a bit per PROCINFO_FIELD */
+typedef struct {
+  _PROCINFO Info;
+  PROCID ProcId;
+  int Loaded;
+} LAZYINFO;
+
+static HANDLES<LAZYINFO>            procInfoMap;
+static HANDLES<std::vector<PROCID>> procListMap;
+
+static void ProcInfoFill(LAZYINFO *info, int field) {
+  _PROCINFO *procInfo = &info->Info; PROCID procId = info->ProcId;
+  if (field == PROCINFO_EXE) {
+    // these two point into per thread buffers, so the info keeps copies
+    char *exe = nullptr; ExeFromProcId(procId, &exe); 
+    procInfo->ExecutableImageFilePath = exe ? strdup(exe) : nullptr;
+  } else if (field == PROCINFO_CWD) {
+    char *cwd = nullptr; CwdFromProcId(procId, &cwd); 
+    procInfo->CurrentWorkingDirectory = cwd ? strdup(cwd) : nullptr;
+  } else if (field == PROCINFO_PARENT) {
+    ParentProcIdFromProcId(procId, &procInfo->ParentProcessId);
+  } else if (field == PROCINFO_CHILDREN) {
+    ProcIdFromParentProcId(procId, &procInfo->ChildProcessId, &procInfo->ChildProcessIdLength);
+  } else if (field == PROCINFO_CMDLINE) {
+    CmdlineFromProcId(procId, &procInfo->CommandLine, &procInfo->CommandLineLength);
+  } else if (field == PROCINFO_ENVIRON) {
+    EnvironFromProcId(procId, &procInfo->Environment, &procInfo->EnvironmentLength);
   #if defined(XPROCESS_GUIWINDOW_IMPL)
-  WINDOWID *wid = nullptr; int widsize = 0;
-  WindowIdFromProcId(procId, &wid, &widsize);
+  } else if (field == PROCINFO_WINDOWS) {
+    WindowIdFromProcId(procId, &procInfo->OwnedWindowId, &procInfo->OwnedWindowIdLength);
   #endif
-  _PROCINFO *procInfo = new _PROCINFO();
-  procInfo->ExecutableImageFilePath = exe;
-  procInfo->CurrentWorkingDirectory = cwd;
-  procInfo->ParentProcessId         = ppid;
-  procInfo->ChildProcessId          = pid;
-  procInfo->ChildProcessIdLength    = pidsize;
-  procInfo->CommandLine             = cmd;
-  procInfo->CommandLineLength       = cmdsize;
-  procInfo->Environment             = env;
-  procInfo->EnvironmentLength       = envsize;
+  }
+  info->Loaded |= field;
+}
+
+static inline _PROCINFO *ProcInfoField(PROCINFO procInfo, int field) {
+  LAZYINFO *info = procInfoMap.Find(procInfo);
+  if (!(info->Loaded & field)) ProcInfoFill(info, field);
+  return &info->Info;
+}
+
+PROCINFO ProcInfoFromProcId(PROCID procId) {
+  LAZYINFO *info = new LAZYINFO();
+  info->ProcId = procId;
+  return procInfoMap.Insert(info);
+}
+
+PROCINFO ProcInfoFromProcIdEx(PROCID procId, int fields) {
+  PROCINFO procInfo = ProcInfoFromProcId(procId);
+  ProcInfoLoad(&procInfo, 1, fields, 1);
+  return procInfo;
+}
+
+/* the parent and children of every info come from one pass over the
+process table, and owned windows from one pass over the window list,
+instead of a pass for each info; the rest is read for each process,
+spread over threads (threads <= 0 uses every hardware thread) */
+void ProcInfoLoad(PROCINFO *procInfo, int size, int fields, int threads) {
+  std::vector<LAZYINFO *> infos; int missing = 0;
+  for (int i = 0; i < size; i++) {
+    LAZYINFO *info = procInfoMap.Find(procInfo[i]);
+    if (info == nullptr) continue;
+    infos.push_back(info); missing |= fields & ~info->Loaded;
+  }
+  if (missing & (PROCINFO_PARENT | PROCINFO_CHILDREN)) {
+    SNAPSHOT snapshot; SnapshotTake(&snapshot, false);
+    for (std::size_t i = 0; i < infos.size(); i++) {
+      LAZYINFO *info = infos[i];
+      if ((missing & PROCINFO_PARENT) && !(info->Loaded & PROCINFO_PARENT)) {
+        int row = SnapshotRow(&snapshot, info->ProcId);
+        info->Info.ParentProcessId = (row >= 0) ? snapshot.ParentProcId[row] : 0;
+        info->Loaded |= PROCINFO_PARENT;
+      }
+      if ((missing & PROCINFO_CHILDREN) && !(info->Loaded & PROCINFO_CHILDREN)) {
+        std::vector<PROCID> vec; SnapshotChildren(&snapshot, info->ProcId, &vec);
+        ProcIdArray(vec, &info->Info.ChildProcessId, &info->Info.ChildProcessIdLength);
+        info->Loaded |= PROCINFO_CHILDREN;
+      }
+    }
+  }
   #if defined(XPROCESS_GUIWINDOW_IMPL)
-  procInfo->OwnedWindowId           = wid;
-  procInfo->OwnedWindowIdLength     = widsize;
+  if (missing & PROCINFO_WINDOWS) {
+    std::vector<PROCID> pidVec; std::vector<std::string> widVec;
+    WindowIdScan(0, &pidVec, &widVec);
+    std::unordered_map<PROCID, std::vector<std::string>> widMap;
+    for (std::size_t j = 0; j < pidVec.size(); j++) widMap[pidVec[j]].push_back(widVec[j]);
+    for (std::size_t i = 0; i < infos.size(); i++) {
+      LAZYINFO *info = infos[i];
+      if (info->Loaded & PROCINFO_WINDOWS) continue;
+      StringArray(widMap[info->ProcId], &info->Info.OwnedWindowId, &info->Info.OwnedWindowIdLength);
+      info->Loaded |= PROCINFO_WINDOWS;
+    }
+  }
   #endif
-  procInfoIndex++; procInfoMap[procInfoIndex] = procInfo;
-  return procInfoIndex;
-}
-
-char *ExecutableImageFilePath(PROCINFO procInfo) { return procInfoMap[procInfo]->ExecutableImageFilePath ? : (char *)""; }
-char *CurrentWorkingDirectory(PROCINFO procInfo) { return procInfoMap[procInfo]->CurrentWorkingDirectory ? : (char *)""; }
-PROCID ParentProcessId(PROCINFO procInfo) { return procInfoMap[procInfo]->ParentProcessId; }
-PROCID *ChildProcessId(PROCINFO procInfo) { return procInfoMap[procInfo]->ChildProcessId; }
-PROCID ChildProcessId(PROCINFO procInfo, int i) { return procInfoMap[procInfo]->ChildProcessId[i]; }
-int ChildProcessIdLength(PROCINFO procInfo) { return procInfoMap[procInfo]->ChildProcessIdLength; }
-char **CommandLine(PROCINFO procInfo) { return procInfoMap[procInfo]->CommandLine; }
-char *CommandLine(PROCINFO procInfo, int i) { return procInfoMap[procInfo]->CommandLine[i]; }
-int CommandLineLength(PROCINFO procInfo) { return procInfoMap[procInfo]->CommandLineLength; }
-char **Environment(PROCINFO procInfo) { return procInfoMap[procInfo]->Environment; }
-char *Environment(PROCINFO procInfo, int i) { return procInfoMap[procInfo]->Environment[i]; }
-int EnvironmentLength(PROCINFO procInfo) { return procInfoMap[procInfo]->EnvironmentLength; }
+  // every info belongs to one worker, which reads all its missing fields
+  ForEachChunk(infos.size(), 16, threads, [&](std::size_t begin, std::size_t end) {
+    for (std::size_t i = begin; i < end; i++) {
+      for (int field = PROCINFO_EXE; field & PROCINFO_ALL; field <<= 1)
+        if ((missing & field) && !(infos[i]->Loaded & field)) ProcInfoFill(infos[i], field);
+    }
+  });
+}
+
+char *ExecutableImageFilePath(PROCINFO procInfo) { return ProcInfoField(procInfo, PROCINFO_EXE)->ExecutableImageFilePath ? : (char *)""; }
+char *CurrentWorkingDirectory(PROCINFO procInfo) { return ProcInfoField(procInfo, PROCINFO_CWD)->CurrentWorkingDirectory ? : (char *)""; }
+PROCID ParentProcessId(PROCINFO procInfo) { return ProcInfoField(procInfo, PROCINFO_PARENT)->ParentProcessId; }
+PROCID *ChildProcessId(PROCINFO procInfo) { return ProcInfoField(procInfo, PROCINFO_CHILDREN)->ChildProcessId; }
+PROCID ChildProcessId(PROCINFO procInfo, int i) { return ProcInfoField(procInfo, PROCINFO_CHILDREN)->ChildProcessId[i]; }
+int ChildProcessIdLength(PROCINFO procInfo) { return ProcInfoField(procInfo, PROCINFO_CHILDREN)->ChildProcessIdLength; }
+char **CommandLine(PROCINFO procInfo) { return ProcInfoField(procInfo, PROCINFO_CMDLINE)->CommandLine; }
+char *CommandLine(PROCINFO procInfo, int i) { return ProcInfoField(procInfo, PROCINFO_CMDLINE)->CommandLine[i]; }
+int CommandLineLength(PROCINFO procInfo) { return ProcInfoField(procInfo, PROCINFO_CMDLINE)->CommandLineLength; }
+char **Environment(PROCINFO procInfo) { return ProcInfoField(procInfo, PROCINFO_ENVIRON)->Environment; }
+char *Environment(PROCINFO procInfo, int i) { return ProcInfoField(procInfo, PROCINFO_ENVIRON)->Environment[i]; }
+int EnvironmentLength(PROCINFO procInfo) { return ProcInfoField(procInfo, PROCINFO_ENVIRON)->EnvironmentLength; }
 #if defined(XPROCESS_GUIWINDOW_IMPL)
-WINDOWID *OwnedWindowId(PROCINFO procInfo) { return procInfoMap[procInfo]->OwnedWindowId; }
-WINDOWID OwnedWindowId(PROCINFO procInfo, int i) { return procInfoMap[procInfo]->OwnedWindowId[i]; }
-int OwnedWindowIdLength(PROCINFO procInfo) { return procInfoMap[procInfo]->OwnedWindowIdLength; }
+WINDOWID *OwnedWindowId(PROCINFO procInfo) { return ProcInfoField(procInfo, PROCINFO_WINDOWS)->OwnedWindowId; }
+WINDOWID OwnedWindowId(PROCINFO procInfo, int i) { return ProcInfoField(procInfo, PROCINFO_WINDOWS)->OwnedWindowId[i]; }
+int OwnedWindowIdLength(PROCINFO procInfo) { return ProcInfoField(procInfo, PROCINFO_WINDOWS)->OwnedWindowIdLength; }
 #endif
 
 void FreeProcInfo(PROCINFO procInfo) {
-  if (procInfoMap.find(procInfo) == procInfoMap.end()) return;
-  FreeProcId(procInfoMap[procInfo]->ChildProcessId);
-  FreeCmdline(procInfoMap[procInfo]->CommandLine);
-  FreeEnviron(procInfoMap[procInfo]->Environment);
+  LAZYINFO *info = procInfoMap.Remove(procInfo);
+  if (info == nullptr) return;
+  free(info->Info.ExecutableImageFilePath);
+  free(info->Info.CurrentWorkingDirectory);
+  FreeProcId(info->Info.ChildProcessId);
+  FreeCmdline(info->Info.CommandLine);
+  FreeEnviron(info->Info.Environment);
   #if defined(XPROCESS_GUIWINDOW_IMPL)
-  FreeWindowId(procInfoMap[procInfo]->OwnedWindowId);
+  FreeWindowId(info->Info.OwnedWindowId);
   #endif
-  delete procInfoMap[procInfo];
-  procInfoMap.erase(procInfo);
+  delete info;
 }
 
 PROCLIST ProcListCreate() { 
   PROCID *procId = nullptr; int size = 0; 
   ProcIdEnumerate(&procId, &size);
+  std::vector<PROCID> *res = new std::vector<PROCID>();
   if (procId) {
-    std::vector<PROCID> res;
-    for (int i = 0; i < size; i++)
-      res.push_back(procId[i]); 
-    procListVec.push_back(res);
+    res->assign(procId, procId + size);
     FreeProcId(procId);
   }
-  procListIndex++;
-  return procListIndex;
+  return procListMap.Insert(res);
 }
 
 PROCID ProcessId(PROCLIST procList, int i) {
-  std::vector<PROCID> procId = procListVec[procList];
-  return procId[i];
+  return (*procListMap.Find(procList))[i];
 }
 
 int ProcessIdLength(PROCLIST procList) {
-  return procListVec[procList].size();
+  std::vector<PROCID> *procId = procListMap.Find(procList);
+  return procId ? (int)procId->size() : 0;
 }
 
 void FreeProcList(PROCLIST procList) {
-  procListVec[procList].clear();
+  delete procListMap.Remove(procList);
+}
+
+static HANDLES<SNAPSHOT> procSnapshotMap;
+
+PROCSNAPSHOT ProcessSnapshotCreate() {
+  SNAPSHOT *snapshot = new SNAPSHOT();
+  SnapshotTake(snapshot, true);
+  return procSnapshotMap.Insert(snapshot);
+}
+
+int ProcessSnapshotLength(PROCSNAPSHOT procSnapshot) {
+  SNAPSHOT *snapshot = procSnapshotMap.Find(procSnapshot);
+  return snapshot ? (int)snapshot->ProcId.size() : 0;
+}
+
+PROCID ProcessSnapshotProcId(PROCSNAPSHOT procSnapshot, int i) {
+  return procSnapshotMap.Find(procSnapshot)->ProcId[i];
+}
+
+PROCID ProcessSnapshotParentProcId(PROCSNAPSHOT procSnapshot, PROCID procId) {
+  SNAPSHOT *snapshot = procSnapshotMap.Find(procSnapshot);
+  if (snapshot == nullptr) return 0;
+  int row = SnapshotRow(snapshot, procId);
+  return (row >= 0) ? snapshot->ParentProcId[row] : 0;
+}
+
+const char *ProcessSnapshotExe(PROCSNAPSHOT procSnapshot, PROCID procId) {
+  SNAPSHOT *snapshot = procSnapshotMap.Find(procSnapshot);
+  if (snapshot == nullptr) return "";
+  int row = SnapshotRow(snapshot, procId);
+  return (row >= 0) ? snapshot->Exe.c_str() + snapshot->ExeOffset[row] : "";
+}
+
+void ProcessSnapshotChildren(PROCSNAPSHOT procSnapshot, PROCID parentProcId, PROCID **procId, int *size) {
+  *procId = nullptr; *size = 0;
+  SNAPSHOT *snapshot = procSnapshotMap.Find(procSnapshot);
+  if (snapshot == nullptr) return;
+  std::vector<PROCID> vec; SnapshotChildren(snapshot, parentProcId, &vec);
+  ProcIdArray(vec, procId, size);
+}
+
+/* breadth first, so children come before grandchildren */
+void ProcessSnapshotDescendants(PROCSNAPSHOT procSnapshot, PROCID parentProcId, PROCID **procId, int *size) {
+  *procId = nullptr; *size = 0;
+  SNAPSHOT *snapshot = procSnapshotMap.Find(procSnapshot);
+  if (snapshot == nullptr) return;
+  std::vector<PROCID> vec; SnapshotChildren(snapshot, parentProcId, &vec);
+  // a pid can't be its own descendant, the table being a tree is all that stops this
+  for (std::size_t j = 0; j < vec.size() && vec.size() <= snapshot->ProcId.size(); j++)
+    SnapshotChildren(snapshot, vec[j], &vec);
+  ProcIdArray(vec, procId, size);
+}
+
+/* parent first, up to the root of the tree */
+void ProcessSnapshotAncestors(PROCSNAPSHOT procSnapshot, PROCID procId, PROCID **parentProcId, int *size) {
+  *parentProcId = nullptr; *size = 0;
+  SNAPSHOT *snapshot = procSnapshotMap.Find(procSnapshot);
+  if (snapshot == nullptr) return;
+  std::vector<PROCID> vec; int row = SnapshotRow(snapshot, procId);
+  while (row >= 0 && vec.size() < snapshot->ProcId.size()) {
+    PROCID parent = snapshot->ParentProcId[row];
+    // a parent missing from the table (pid 0, or one that already exited) ends it
+    if (parent == snapshot->ProcId[row] || (row = SnapshotRow(snapshot, parent)) < 0) break;
+    vec.push_back(parent);
+  }
+  ProcIdArray(vec, parentProcId, size);
+}
+
+void FreeProcessSnapshot(PROCSNAPSHOT procSnapshot) {
+  delete procSnapshotMap.Remove(procSnapshot);
+}
+
+static HANDLES<WATCHER> procWatcherMap;
+
+PROCWATCHER ProcessWatcherCreate() {
+  WATCHER *watcher = new WATCHER();
+  #if !defined(_WIN32) && !(defined(__linux__) && !defined(__ANDROID__))
+  watcher->Queue = kqueue();
+  #endif
+  return procWatcherMap.Insert(watcher);
+}
+
+/* false if the process is already gone (or can't be opened), in which
+case there is nothing to wait for */
+bool ProcessWatcherAdd(PROCWATCHER procWatcher, PROCID procId) {
+  WATCHER *watcher = procWatcherMap.Find(procWatcher);
+  if (watcher == nullptr) return false;
+  #if defined(_WIN32)
+  if (watcher->Handle.size() >= MAXIMUM_WAIT_OBJECTS) return false;
+  HANDLE proc = OpenProcess(SYNCHRONIZE, false, procId);
+  if (proc == nullptr) return false;
+  watcher->Handle.push_back(proc);
+  #elif (defined(__linux__) && !defined(__ANDROID__))
+  int fd = (int)syscall(SYS_pidfd_open, procId, 0);
+  if (fd == -1 && errno != ENOSYS) return false;
+  if (fd == -1 && ProcExited(procId)) return false;
+  if (fd != -1) fcntl(fd, F_SETFD, FD_CLOEXEC);
+  watcher->Fd.push_back(fd);
+  #else
+  struct kevent change;
+  EV_SET(&change, procId, EVFILT_PROC, EV_ADD | EV_ONESHOT, NOTE_EXIT, 0, nullptr);
+  if (watcher->Queue == -1 || kevent(watcher->Queue, &change, 1, nullptr, 0, nullptr) == -1) return false;
+  #endif
+  watcher->ProcId.push_back(procId);
+  return true;
+}
+
+void ProcessWatcherRemove(PROCWATCHER procWatcher, PROCID procId) {
+  WATCHER *watcher = procWatcherMap.Find(procWatcher);
+  if (watcher == nullptr) return;
+  std::vector<PROCID>::iterator it = std::find(watcher->ProcId.begin(), watcher->ProcId.end(), procId);
+  if (it == watcher->ProcId.end()) return;
+  std::size_t j = it - watcher->ProcId.begin();
+  #if defined(_WIN32)
+  CloseHandle(watcher->Handle[j]);
+  watcher->Handle.erase(watcher->Handle.begin() + j);
+  #elif (defined(__linux__) && !defined(__ANDROID__))
+  if (watcher->Fd[j] != -1) close(watcher->Fd[j]);
+  watcher->Fd.erase(watcher->Fd.begin() + j);
+  #else
+  struct kevent change;
+  EV_SET(&change, procId, EVFILT_PROC, EV_DELETE, 0, 0, nullptr);
+  kevent(watcher->Queue, &change, 1, nullptr, 0, nullptr);
+  #endif
+  watcher->ProcId.erase(it);
+}
+
+/* blocks until one of the processes exits and returns it, no longer
+watched, or returns 0 once timeout milliseconds pass (-1 waits forever);
+nothing being watched returns 0 straight away */
+PROCID ProcessWatcherWait(PROCWATCHER procWatcher, int timeout) {
+  WATCHER *watcher = procWatcherMap.Find(procWatcher);
+  if (watcher == nullptr) return 0;
+  if (watcher->ProcId.empty()) return 0;
+  PROCID procId = 0;
+  #if defined(_WIN32)
+  DWORD result = WaitForMultipleObjects((DWORD)watcher->Handle.size(), watcher->Handle.data(), 
+  false, (timeout < 0) ? INFINITE : (DWORD)timeout);
+  if (result >= WAIT_OBJECT_0 && result < WAIT_OBJECT_0 + watcher->Handle.size())
+    procId = watcher->ProcId[result - WAIT_OBJECT_0];
+  #elif (defined(__linux__) && !defined(__ANDROID__))
+  std::vector<pollfd> fds; bool fallback = false;
+  for (std::size_t j = 0; j < watcher->Fd.size(); j++) {
+    pollfd fd = { watcher->Fd[j], POLLIN, 0 }; fds.push_back(fd);
+    if (watcher->Fd[j] == -1) fallback = true;
+  }
+  // without pidfds there is no event to block on, so check with a growing interval
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + 
+  std::chrono::milliseconds(std::max(timeout, 0)); int slice = 1;
+  while (!procId) {
+    for (std::size_t j = 0; fallback && j < watcher->Fd.size(); j++)
+      if (watcher->Fd[j] == -1 && ProcExited(watcher->ProcId[j])) { procId = watcher->ProcId[j]; break; }
+    if (procId) break;
+    int wait = -1;
+    if (timeout >= 0) {
+      wait = (int)std::chrono::duration_cast<std::chrono::milliseconds>(
+      deadline - std::chrono::steady_clock::now()).count(); wait = std::max(wait, 0);
+    }
+    if (fallback) { wait = (wait < 0) ? slice : std::min(wait, slice); slice = std::min(slice * 2, 64); }
+    int ready = poll(fds.data(), fds.size(), wait);
+    if (ready == -1 && errno != EINTR) break;
+    for (std::size_t j = 0; ready > 0 && j < fds.size(); j++)
+      if (fds[j].fd != -1 && fds[j].revents) { procId = watcher->ProcId[j]; break; }
+    if (!procId && timeout >= 0 && std::chrono::steady_clock::now() >= deadline) break;
+  }
+  #else
+  struct kevent event; timespec ts = { timeout / 1000, (timeout % 1000) * 1000000L };
+  if (kevent(watcher->Queue, nullptr, 0, &event, 1, (timeout < 0) ? nullptr : &ts) == 1)
+    procId = (PROCID)event.ident;
+  #endif
+  if (procId) ProcessWatcherRemove(procWatcher, procId);
+  return procId;
+}
+
+void FreeProcessWatcher(PROCWATCHER procWatcher) {
+  WATCHER *watcher = procWatcherMap.Find(procWatcher);
+  if (watcher == nullptr) return;
+  while (!watcher->ProcId.empty()) ProcessWatcherRemove(procWatcher, watcher->ProcId.back());
+  #if !defined(_WIN32) && !(defined(__linux__) && !defined(__ANDROID__))
+  if (watcher->Queue != -1) close(watcher->Queue);
+  #endif
+  delete procWatcherMap.Remove(procWatcher);
+}
+
+bool ProcIdWaitForExit(PROCID procId, int timeout) {
+  PROCWATCHER procWatcher = ProcessWatcherCreate();
+  bool exited = !ProcessWatcherAdd(procWatcher, procId) || ProcessWatcherWait(procWatcher, timeout) == procId;
+  FreeProcessWatcher(procWatcher);
+  return exited;
 }
 
 #if !defined(_WIN32)
+extern "C" char **environ;
+
+static inline int PipeCloexec(int fds[2]) {
+  #if (defined(__linux__) && !defined(__ANDROID__)) || defined(__FreeBSD__) || defined(__DragonFly__)
+  return pipe2(fds, O_CLOEXEC);
+  #else
+  if (pipe(fds) == -1) return -1;
+  fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+  fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+  return 0;
+  #endif
+}
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 34))
+#define XPROCESS_SPAWN_CLOSEFROM
+#endif
+
+#if !defined(XPROCESS_SPAWN_CLOSEFROM) && !defined(POSIX_SPAWN_CLOEXEC_DEFAULT)
+static inline void SpawnAddClose(posix_spawn_file_actions_t *actions, int fd) {
+  int flags = fcntl(fd, F_GETFD);
+  if (flags != -1 && !(flags & FD_CLOEXEC))
+    posix_spawn_file_actions_addclose(actions, fd);
+}
+
+/* a close action for every descriptor past stderr left inheritable, for
+platforms with no closefrom to hand the child; they're listed from
+/proc/self/fd where there is one, else probed up to the descriptor limit.
+Marking them close on exec instead would change them for the host too */
+static inline void SpawnAddCloseInherited(posix_spawn_file_actions_t *actions) {
+  DIR *dir = opendir("/proc/self/fd");
+  if (dir) {
+    struct dirent *entry = nullptr;
+    while ((entry = readdir(dir))) {
+      if (entry->d_name[0] < '0' || entry->d_name[0] > '9') continue;
+      int fd = (int)strtol(entry->d_name, nullptr, 10);
+      if (fd > 2 && fd != dirfd(dir)) SpawnAddClose(actions, fd);
+    }
+    closedir(dir);
+    return;
+  }
+  long limit = sysconf(_SC_OPEN_MAX);
+  if (limit < 0 || limit > 65536) limit = 65536;
+  for (int fd = 3; fd < limit; fd++) SpawnAddClose(actions, fd);
+}
+#endif
+
+/* posix_spawn() is a vfork() and exec() in glibc and the BSDs, so nothing
+of this process is copied to run the shell; our pipe ends are close on
+exec, only the dup2()ed copies make it into the child, and any other
+descriptor someone left inheritable is closed, by closefrom in glibc
+2.34, CLOEXEC_DEFAULT on macOS, or a close action apiece elsewhere */
 static inline PROCID ProcessExecuteHelper(const char *command, int *infp, int *outfp) {
   int p_stdin[2];
   int p_stdout[2];
   PROCID pid = -1;
-  if (pipe(p_stdin) == -1)
+  if (PipeCloexec(p_stdin) == -1)
     return -1;
-  if (pipe(p_stdout) == -1) {
+  if (PipeCloexec(p_stdout) == -1) {
     close(p_stdin[0]);
     close(p_stdin[1]);
     return -1;
   }
-  pid = fork();
-  if (pid < 0) {
-    close(p_stdin[0]);
-    close(p_stdin[1]);
-    close(p_stdout[0]);
-    close(p_stdout[1]);
-    return pid;
-  } else if (pid == 0) {
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_adddup2(&actions, p_stdin[0], 0);
+  posix_spawn_file_actions_adddup2(&actions, p_stdout[1], 1);
+  posix_spawn_file_actions_addopen(&actions, 2, "/dev/null", O_WRONLY, 0);
+  #if defined(XPROCESS_SPAWN_CLOSEFROM)
+  posix_spawn_file_actions_addclosefrom_np(&actions, 3);
+  #elif !defined(POSIX_SPAWN_CLOEXEC_DEFAULT)
+  SpawnAddCloseInherited(&actions);
+  #endif
+  posix_spawnattr_t attr; short flags = 0;
+  posix_spawnattr_init(&attr);
+  #if defined(POSIX_SPAWN_SETSID)
+  flags |= POSIX_SPAWN_SETSID;
+  #else
+  flags |= POSIX_SPAWN_SETPGROUP;
+  #endif
+  #if defined(POSIX_SPAWN_CLOEXEC_DEFAULT)
+  flags |= POSIX_SPAWN_CLOEXEC_DEFAULT;
+  #endif
+  posix_spawnattr_setflags(&attr, flags);
+  char *argv[] = { (char *)"/bin/sh", (char *)"-c", (char *)command, nullptr };
+  if (posix_spawn(&pid, "/bin/sh", &actions, &attr, argv, environ) != 0)
+    pid = -1;
+  posix_spawnattr_destroy(&attr);
+  posix_spawn_file_actions_destroy(&actions);
+  close(p_stdin[0]);
+  close(p_stdout[1]);
+  if (pid == -1) {
     close(p_stdin[1]);
-    dup2(p_stdin[0], 0);
     close(p_stdout[0]);
-    dup2(p_stdout[1], 1);
-    dup2(open("/dev/null", O_WRONLY), 2);
-    for (int i = 3; i < 4096; i++)
-      close(i);
-    setsid();
-    execl("/bin/sh", "/bin/sh", "-c", command, nullptr);
-    _exit(-1);
+    return -1;
   }
-  close(p_stdin[0]);
-  close(p_stdout[1]);
   if (infp == nullptr) {
     close(p_stdin[1]);
   } else {
@@ -1411,60 +2111,307 @@ static inline PROCID ProcessExecuteHelper(const char *command, int *infp, int *o
   }
   return pid;
 }
+
+static inline void OutputAppend(PROCESS procIndex, const char *buffer, std::size_t nRead) {
+  std::lock_guard<std::mutex> guard(stdOptMutex);
+  stdOptMap[procIndex].append(buffer, nRead);
+}
 #endif
 
-static inline void OutputThread(std::intptr_t file, PROCESS procIndex) {
+static void InputClose(STDINPUT *input) {
   #if !defined(_WIN32)
-  ssize_t nRead = 0; char buffer[BUFSIZ];
-  while ((nRead = read((int)file, buffer, BUFSIZ)) > 0) {
-    buffer[nRead] = '\0';
+  close((int)input->File);
   #else
-  DWORD nRead = 0; char buffer[BUFSIZ];
-  while (ReadFile((HANDLE)(void *)file, buffer, BUFSIZ, &nRead, nullptr) && nRead) {
-    buffer[nRead] = '\0';
+  CloseHandle((HANDLE)(void *)input->File);
   #endif
-    std::lock_guard<std::mutex> guard(stdOptMutex);
-    stdOptMap[procIndex].append(buffer, nRead);
-  }
+  delete input;
+}
+
+/* the entry takes the pipe over, FreeExecutedProcessStandardInput() lets
+go of it and the last writer out, if any, closes it */
+static inline void InputSet(PROCESS procIndex, std::intptr_t file) {
+  STDINPUT *input = new STDINPUT(); input->File = file;
+  std::shared_ptr<STDINPUT> entry(input, InputClose);
+  std::lock_guard<std::mutex> guard(stdIptMutex);
+  stdIptMap[procIndex] = entry;
 }
 
-static int index = -1;
-static std::unordered_map<int, PROCID>  childProcId;
-static std::unordered_map<int, bool> procDidExecute;
+static inline void CompletionSet(PROCESS procIndex, bool complete) {
+  std::lock_guard<std::mutex> guard(stdOptMutex);
+  completeMap[procIndex] = complete;
+}
+
+/* what ProcessExecuteAsync() streams into, the accumulated string the
+ExecutedProcessReadFromStandardOutput() callers expect */
+static void OutputAccumulate(PROCESS procIndex, const char *output, int length, void *userData) {
+  if (!output) return;
+  std::lock_guard<std::mutex> guard(stdOptMutex);
+  stdOptMap[procIndex].append(output, length);
+}
 
 #if !defined(_WIN32)
-static inline PROCID ProcIdFromForkProcId(PROCID procId) {
-  PROCID *pid = nullptr; int pidsize = 0;
-  std::this_thread::sleep_for(std::chrono::milliseconds(5));
-  ProcIdFromParentProcId(procId, &pid, &pidsize);
-  if (pid) { if (pidsize) { procId = pid[pidsize - 1]; }
-  FreeProcId(pid); } 
-  return procId;
+/* one loop over the child's stdout and its exit: output is appended as it
+arrives, and once the shell is gone whatever is already in the pipe is
+taken and the rest left, so a background job holding stdout open can't
+keep the call from returning; without a pidfd, stdout closing ends it */
+static inline void OutputLoop(int file, PROCID procId, PROCESS procIndex) {
+  char buffer[BUFSIZ]; ssize_t nRead = 0;
+  #if (defined(__linux__) && !defined(__ANDROID__))
+  int pidfd = (int)syscall(SYS_pidfd_open, procId, 0);
+  #else
+  int pidfd = -1;
+  #endif
+  pollfd fds[2] = { { file, POLLIN, 0 }, { pidfd, POLLIN, 0 } };
+  bool open = true;
+  while (open) {
+    if (poll(fds, (pidfd != -1) ? 2 : 1, -1) == -1) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    if (fds[0].revents) {
+      if ((nRead = read(file, buffer, BUFSIZ)) > 0) OutputAppend(procIndex, buffer, nRead);
+      else if (nRead == 0 || errno != EINTR) open = false;
+    } else if (pidfd != -1 && fds[1].revents) {
+      fcntl(file, F_SETFL, fcntl(file, F_GETFL) | O_NONBLOCK);
+      while ((nRead = read(file, buffer, BUFSIZ)) > 0) OutputAppend(procIndex, buffer, nRead);
+      open = false;
+    }
+  }
+  if (pidfd != -1) close(pidfd);
+  int status = 0; while (waitpid(procId, &status, 0) == -1 && errno == EINTR);
+}
+
+/* every streaming child is served by one reactor thread, epoll on Linux
+and poll() elsewhere; the callback sees chunks straight out of the
+reactor's read buffer, so there is no copy and no lock per chunk */
+typedef struct STREAM STREAM;
+typedef struct {
+  STREAM *Stream;
+  bool Exit;
+} SOURCE;
+
+struct STREAM {
+  PROCESS Process;
+  int Out, Pidfd;
+  bool Reaped;
+  PROCOUTPUTCALLBACK Callback;
+  void *UserData;
+  SOURCE OutSource, ExitSource;
+};
+
+// never destroyed, the detached reactor thread may still be in them at exit
+static std::mutex reactorMutex;
+static std::vector<STREAM *> &reactorPending = *new std::vector<STREAM *>();
+static std::vector<STREAM *> &reactorActive = *new std::vector<STREAM *>();
+static int reactorWake[2] = { -1, -1 };
+static int reactorSlice = 1;
+#if (defined(__linux__) && !defined(__ANDROID__))
+static int reactorEpoll = -1;
+#endif
+
+/* stdout closed but the child may well be running on, and there's no
+pidfd to say when it stops, so the reactor checks on a growing interval */
+static inline bool ReactorParked(STREAM *stream) {
+  return stream->Out == -1 && stream->Pidfd == -1;
+}
+
+/* reaps the child if it has exited, never blocking the reactor on one
+that hasn't; ECHILD means someone else reaped it, which is as good */
+static inline bool ReactorReap(STREAM *stream) {
+  int status = 0; pid_t result = 0;
+  while ((result = waitpid(stream->Process, &status, WNOHANG)) == -1 && errno == EINTR);
+  stream->Reaped = (result != 0);
+  return stream->Reaped;
+}
+
+static inline void ReactorWatch(STREAM *stream) {
+  #if (defined(__linux__) && !defined(__ANDROID__))
+  epoll_event event = { 0 }; event.events = EPOLLIN;
+  event.data.ptr = &stream->OutSource;
+  epoll_ctl(reactorEpoll, EPOLL_CTL_ADD, stream->Out, &event);
+  if (stream->Pidfd != -1) {
+    event.data.ptr = &stream->ExitSource;
+    epoll_ctl(reactorEpoll, EPOLL_CTL_ADD, stream->Pidfd, &event);
+  }
+  #endif
+  reactorActive.push_back(stream);
+}
+
+/* the child is done: whatever is still in the pipe is delivered if it
+exited, then the end of output is, and everything it held is let go;
+unless it was reaped already the pidfd said it exited, so the wait for
+it here doesn't block */
+static inline void ReactorFinish(STREAM *stream, bool exited, char *buffer, std::size_t size) {
+  ssize_t nRead = 0;
+  if (exited && stream->Out != -1) {
+    fcntl(stream->Out, F_SETFL, fcntl(stream->Out, F_GETFL) | O_NONBLOCK);
+    while ((nRead = read(stream->Out, buffer, size)) > 0) 
+      stream->Callback(stream->Process, buffer, (int)nRead, stream->UserData);
+  }
+  #if (defined(__linux__) && !defined(__ANDROID__))
+  if (stream->Out != -1) epoll_ctl(reactorEpoll, EPOLL_CTL_DEL, stream->Out, nullptr);
+  if (stream->Pidfd != -1) epoll_ctl(reactorEpoll, EPOLL_CTL_DEL, stream->Pidfd, nullptr);
+  #endif
+  if (stream->Out != -1) close(stream->Out);
+  if (stream->Pidfd != -1) close(stream->Pidfd);
+  int status = 0; while (!stream->Reaped && waitpid(stream->Process, &status, 0) == -1 && errno == EINTR);
+  FreeExecutedProcessStandardInput(stream->Process);
+  CompletionSet(stream->Process, true);
+  stream->Callback(stream->Process, nullptr, 0, stream->UserData);
+  reactorActive.erase(std::find(reactorActive.begin(), reactorActive.end(), stream));
+  delete stream;
+}
+
+/* output is handled before exits, so a child whose output and exit come
+in the same wakeup has its output read the ordinary way first */
+static inline void ReactorEvent(SOURCE *source, char *buffer, std::size_t size) {
+  STREAM *stream = source->Stream;
+  if (source->Exit) {
+    ReactorFinish(stream, true, buffer, size);
+    return;
+  }
+  ssize_t nRead = read(stream->Out, buffer, size);
+  if (nRead > 0) stream->Callback(stream->Process, buffer, (int)nRead, stream->UserData);
+  else if (nRead == 0 || errno != EINTR) {
+    // stdout closed, the child is only done once the pidfd or a reap says so
+    #if (defined(__linux__) && !defined(__ANDROID__))
+    epoll_ctl(reactorEpoll, EPOLL_CTL_DEL, stream->Out, nullptr);
+    #endif
+    close(stream->Out); stream->Out = -1;
+    if (stream->Pidfd != -1) return;
+    if (ReactorReap(stream)) ReactorFinish(stream, false, buffer, size);
+    else reactorSlice = 1;
+  }
+}
+
+static void ReactorLoop() {
+  static char buffer[65536];
+  while (true) {
+    std::vector<SOURCE *> ready; bool wake = false;
+    int timeout = -1;
+    for (std::size_t i = 0; i < reactorActive.size(); i++) {
+      if (!ReactorParked(reactorActive[i])) continue;
+      timeout = reactorSlice; reactorSlice = std::min(reactorSlice * 2, 64);
+      break;
+    }
+    #if (defined(__linux__) && !defined(__ANDROID__))
+    epoll_event events[64];
+    int count = epoll_wait(reactorEpoll, events, 64, timeout);
+    for (int i = 0; i < count; i++) {
+      if (events[i].data.ptr == nullptr) wake = true;
+      else ready.push_back((SOURCE *)events[i].data.ptr);
+    }
+    #else
+    std::vector<pollfd> fds; std::vector<SOURCE *> sources;
+    pollfd wakefd = { reactorWake[0], POLLIN, 0 }; fds.push_back(wakefd); sources.push_back(nullptr);
+    for (std::size_t i = 0; i < reactorActive.size(); i++) {
+      if (reactorActive[i]->Out == -1) continue;
+      pollfd outfd = { reactorActive[i]->Out, POLLIN, 0 };
+      fds.push_back(outfd); sources.push_back(&reactorActive[i]->OutSource);
+    }
+    int count = poll(fds.data(), fds.size(), timeout);
+    for (std::size_t i = 0; count > 0 && i < fds.size(); i++) {
+      if (!fds[i].revents) continue;
+      if (sources[i] == nullptr) wake = true;
+      else ready.push_back(sources[i]);
+    }
+    #endif
+    std::stable_partition(ready.begin(), ready.end(), [](SOURCE *source) { return !source->Exit; });
+    std::vector<STREAM *> finished;
+    for (std::size_t i = 0; i < ready.size(); i++) {
+      // a stream that finished earlier in this batch is already freed
+      if (std::find(finished.begin(), finished.end(), ready[i]->Stream) != finished.end()) continue;
+      STREAM *stream = ready[i]->Stream; std::size_t before = reactorActive.size();
+      ReactorEvent(ready[i], buffer, sizeof(buffer));
+      if (reactorActive.size() != before) finished.push_back(stream);
+    }
+    for (std::size_t i = reactorActive.size(); i-- > 0;) {
+      if (ReactorParked(reactorActive[i]) && ReactorReap(reactorActive[i]))
+        ReactorFinish(reactorActive[i], false, buffer, sizeof(buffer));
+    }
+    if (wake) {
+      char drain[64]; while (read(reactorWake[0], drain, sizeof(drain)) > 0);
+      std::lock_guard<std::mutex> guard(reactorMutex);
+      for (std::size_t i = 0; i < reactorPending.size(); i++) ReactorWatch(reactorPending[i]);
+      reactorPending.clear();
+    }
+  }
+}
+
+static inline bool ReactorStart() {
+  static bool started = false;
+  if (started) return true;
+  if (PipeCloexec(reactorWake) == -1) return false;
+  fcntl(reactorWake[0], F_SETFL, fcntl(reactorWake[0], F_GETFL) | O_NONBLOCK);
+  #if (defined(__linux__) && !defined(__ANDROID__))
+  reactorEpoll = epoll_create1(EPOLL_CLOEXEC);
+  if (reactorEpoll == -1) return false;
+  epoll_event event = { 0 }; event.events = EPOLLIN; event.data.ptr = nullptr;
+  epoll_ctl(reactorEpoll, EPOLL_CTL_ADD, reactorWake[0], &event);
+  #endif
+  std::thread(ReactorLoop).detach();
+  started = true;
+  return true;
+}
+
+/* spawns command and hands its output to the reactor, false if either fails */
+static inline PROCESS ReactorExecute(const char *command, PROCOUTPUTCALLBACK callback, void *userData) {
+  {
+    std::lock_guard<std::mutex> guard(reactorMutex);
+    if (!ReactorStart()) return 0;
+  }
+  int infd = -1, outfd = -1;
+  PROCID procId = ProcessExecuteHelper(command, &infd, &outfd);
+  if (procId == -1) return 0;
+  STREAM *stream = new STREAM();
+  stream->Process = (PROCESS)procId; stream->Out = outfd;
+  #if (defined(__linux__) && !defined(__ANDROID__))
+  stream->Pidfd = (int)syscall(SYS_pidfd_open, procId, 0);
+  #else
+  stream->Pidfd = -1;
+  #endif
+  stream->Reaped = false;
+  stream->Callback = callback; stream->UserData = userData;
+  stream->OutSource.Stream = stream; stream->OutSource.Exit = false;
+  stream->ExitSource.Stream = stream; stream->ExitSource.Exit = true;
+  InputSet(stream->Process, (std::intptr_t)infd);
+  CompletionSet(stream->Process, false);
+  PROCESS procIndex = stream->Process;
+  std::lock_guard<std::mutex> guard(reactorMutex);
+  reactorPending.push_back(stream);
+  char wake = 0; write(reactorWake[1], &wake, 1);
+  return procIndex;
 }
 #endif
 
-PROCESS ProcessExecute(const char *command) {
-  index++;
+#if defined(_WIN32)
+static inline void OutputThread(std::intptr_t file, PROCESS procIndex, PROCOUTPUTCALLBACK callback, void *userData) {
+  DWORD nRead = 0; char buffer[BUFSIZ];
+  while (ReadFile((HANDLE)(void *)file, buffer, BUFSIZ, &nRead, nullptr) && nRead) {
+    callback(procIndex, buffer, (int)nRead, userData);
+  }
+}
+#endif
+
+/* started, when given, receives the process as soon as it exists, which
+is all ProcessExecuteAsync() waits for before handing it back */
+static void ProcessExecuteImpl(const char *command, std::promise<PROCESS> *started,
+  PROCOUTPUTCALLBACK callback, void *userData) {
+  PROCESS procIndex = 0;
   #if !defined(_WIN32)
-  int infd = 0, outfd = 0; 
-  PROCID procId = 0, forkProcId = 0, waitProcId = 0;
-  forkProcId = ProcessExecuteHelper(command, &infd, &outfd);
-  procId = forkProcId; waitProcId = procId; 
-  std::this_thread::sleep_for(std::chrono::milliseconds(5));
-  if (forkProcId != -1) {
-    while ((procId = ProcIdFromForkProcId(procId)) == waitProcId) {
-      std::this_thread::sleep_for(std::chrono::milliseconds(5));
-      int status; waitProcId = waitpid(forkProcId, &status, WNOHANG);
-      char **cmd = nullptr; int cmdsize; CmdlineFromProcId(forkProcId, &cmd, &cmdsize);
-      if (cmd) { if (cmdsize && strcmp(cmd[0], "/bin/sh") == 0) {
-      if (waitProcId > 0) procId = waitProcId; } FreeCmdline(cmd); }
-    }
-  } else { procId = 0; }
-  childProcId[index] = procId; std::this_thread::sleep_for(std::chrono::milliseconds(5));
-  procDidExecute[index] = true; PROCESS procIndex = (PROCESS)procId;
-  stdIptMap.insert(std::make_pair(procIndex, (std::intptr_t)infd));
-  std::thread optThread(OutputThread, (std::intptr_t)outfd, procIndex);
-  optThread.join();
+  int infd = -1, outfd = -1;
+  PROCID procId = ProcessExecuteHelper(command, &infd, &outfd);
+  if (procId == -1) {
+    if (started) started->set_value(0);
+    return;
+  }
+  procIndex = (PROCESS)procId;
+  InputSet(procIndex, (std::intptr_t)infd);
+  CompletionSet(procIndex, false);
+  if (started) started->set_value(procIndex);
+  OutputLoop(outfd, procId, procIndex);
+  close(outfd);
+  FreeExecutedProcessStandardInput(procIndex);
   #else
   wchar_t cwstr_command[32768];
   std::wstring wstr_command = widen(command); bool proceed = true;
@@ -1473,25 +2420,26 @@ PROCESS ProcessExecute(const char *command) {
   HANDLE hStdOutPipeRead = nullptr; HANDLE hStdOutPipeWrite = nullptr;
   SECURITY_ATTRIBUTES sa = { sizeof(SECURITY_ATTRIBUTES), nullptr, true };
   proceed = CreatePipe(&hStdInPipeRead, &hStdInPipeWrite, &sa, 0);
-  if (proceed == false) return 0;
+  if (proceed == false) { if (started) started->set_value(0); return; }
   SetHandleInformation(hStdInPipeWrite, HANDLE_FLAG_INHERIT, 0);
   proceed = CreatePipe(&hStdOutPipeRead, &hStdOutPipeWrite, &sa, 0);
-  if (proceed == false) return 0;
+  if (proceed == false) { if (started) started->set_value(0); return; }
   STARTUPINFOW si = { 0 };
   si.cb = sizeof(STARTUPINFOW);
   si.dwFlags = STARTF_USESTDHANDLES;
   si.hStdError = hStdOutPipeWrite;
   si.hStdOutput = hStdOutPipeWrite;
   si.hStdInput = hStdInPipeRead;
-  PROCESS_INFORMATION pi = { 0 }; PROCESS procIndex = 0;
+  PROCESS_INFORMATION pi = { 0 };
   if (CreateProcessW(nullptr, cwstr_command, nullptr, nullptr, true, CREATE_NO_WINDOW, nullptr, nullptr, &si, &pi)) {
     CloseHandle(hStdOutPipeWrite);
     CloseHandle(hStdInPipeRead);
-    PROCID procId = pi.dwProcessId; childProcId[index] = procId; procIndex = (PROCESS)procId;
-    std::this_thread::sleep_for(std::chrono::milliseconds(5)); procDidExecute[index] = true;
-    stdIptMap.insert(std::make_pair(procIndex, (std::intptr_t)(void *)hStdInPipeWrite));
+    procIndex = (PROCESS)pi.dwProcessId;
+    InputSet(procIndex, (std::intptr_t)(void *)hStdInPipeWrite);
+    CompletionSet(procIndex, false);
+    if (started) started->set_value(procIndex);
     MSG msg; HANDLE waitHandles[] = { pi.hProcess, hStdOutPipeRead };
-    std::thread optThread(OutputThread, (std::intptr_t)(void *)hStdOutPipeRead, procIndex);
+    std::thread optThread(OutputThread, (std::intptr_t)(void *)hStdOutPipeRead, procIndex, callback, userData);
     while (MsgWaitForMultipleObjects(2, waitHandles, false, 5, QS_ALLEVENTS) != WAIT_OBJECT_0) {
       while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
         TranslateMessage(&msg);
@@ -1502,66 +2450,100 @@ PROCESS ProcessExecute(const char *command) {
     CloseHandle(pi.hProcess);
     CloseHandle(pi.hThread);
     CloseHandle(hStdOutPipeRead);
-    CloseHandle(hStdInPipeWrite);
-  } else { 
-    procDidExecute[index] = true;
-    childProcId[index] = 0;
+    FreeExecutedProcessStandardInput(procIndex);
+  } else {
+    CloseHandle(hStdInPipeRead); CloseHandle(hStdInPipeWrite);
+    CloseHandle(hStdOutPipeRead); CloseHandle(hStdOutPipeWrite);
+    if (started) started->set_value(0);
+    return;
   }
   #endif
-  FreeExecutedProcessStandardInput(procIndex);
-  std::this_thread::sleep_for(std::chrono::milliseconds(100));
-  completeMap[procIndex] = true;
-  return procIndex;
+  CompletionSet(procIndex, true);
+  if (callback) callback(procIndex, nullptr, 0, userData);
+}
+
+/* the process returned is the shell's; bash, dash and zsh exec the last
+simple command of -c in place, so for a single command that is the
+command itself */
+PROCESS ProcessExecute(const char *command) {
+  std::promise<PROCESS> started;
+  std::future<PROCESS> procIndex = started.get_future();
+  ProcessExecuteImpl(command, &started, OutputAccumulate, nullptr);
+  return procIndex.get();
 }
 
 PROCESS ProcessExecuteAsync(const char *command) {
-  int prevIndex = index;
-  std::thread procThread(ProcessExecute, command);
-  while (prevIndex == index)
-    std::this_thread::sleep_for(std::chrono::milliseconds(5));
-  while (procDidExecute.find(index) == procDidExecute.end() || !procDidExecute[index])
-    std::this_thread::sleep_for(std::chrono::milliseconds(5));
-  PROCESS procIndex = (PROCESS)childProcId[index];
-  completeMap[procIndex] = false;
+  return ProcessExecuteStreaming(command, OutputAccumulate, nullptr);
+}
+
+PROCESS ProcessExecuteStreaming(const char *command, PROCOUTPUTCALLBACK callback, void *userData) {
+  #if !defined(_WIN32)
+  return ReactorExecute(command, callback, userData);
+  #else
+  // the thread outlives this call, so it gets its own command and promise
+  std::promise<PROCESS> started;
+  std::future<PROCESS> procIndex = started.get_future();
+  std::thread procThread([](std::string command, std::promise<PROCESS> started, 
+    PROCOUTPUTCALLBACK callback, void *userData) {
+    ProcessExecuteImpl(command.c_str(), &started, callback, userData);
+  }, std::string(command), std::move(started), callback, userData);
   procThread.detach();
-  return procIndex;
+  return procIndex.get();
+  #endif
 }
 
 void ExecutedProcessWriteToStandardInput(PROCESS procIndex, const char *input) {
-  if (stdIptMap.find(procIndex) == stdIptMap.end()) return;
+  std::shared_ptr<STDINPUT> stdInput;
+  {
+    std::lock_guard<std::mutex> guard(stdIptMutex);
+    std::unordered_map<PROCESS, std::shared_ptr<STDINPUT> >::iterator it = stdIptMap.find(procIndex);
+    if (it == stdIptMap.end()) return;
+    stdInput = it->second;
+  }
+  // the reference keeps the pipe open even if the process is freed meanwhile
+  std::lock_guard<std::mutex> guard(stdInput->Mutex);
   std::string str = input; char *buffer = new char[str.length() + 1]();
   #if !defined(_WIN32)
   strcpy(buffer, str.c_str());
-  write((int)stdIptMap[procIndex], buffer, str.length() + 1);
+  write((int)stdInput->File, buffer, str.length() + 1);
   #else
   strncpy_s(buffer, str.length() + 1, str.c_str(), str.length() + 1);
-  DWORD dwWritten; WriteFile((HANDLE)(void *)stdIptMap[procIndex], buffer, 
+  DWORD dwWritten; WriteFile((HANDLE)(void *)stdInput->File, buffer, 
   str.length() + 1, &dwWritten, nullptr);
   #endif
   delete[] buffer;
 }
 
+/* valid until the next call on the same thread */
 const char *ExecutedProcessReadFromStandardOutput(PROCESS procIndex) {
-  if (stdOptMap.find(procIndex) == stdOptMap.end()) return "";
-  std::lock_guard<std::mutex> guard(stdOptMutex);
-  return stdOptMap.find(procIndex)->second.c_str();
+  static thread_local std::string str; str = OutputCopy(procIndex);
+  return str.c_str();
 }
 
 void FreeExecutedProcessStandardInput(PROCESS procIndex) {
-  if (stdIptMap.find(procIndex) == stdIptMap.end()) return;
+  std::lock_guard<std::mutex> guard(stdIptMutex);
   stdIptMap.erase(procIndex);
 }
 
 void FreeExecutedProcessStandardOutput(PROCESS procIndex) {
-  if (stdOptMap.find(procIndex) == stdOptMap.end()) return;
+  std::lock_guard<std::mutex> guard(stdOptMutex);
   stdOptMap.erase(procIndex);
 }
 
 bool CompletionStatusFromExecutedProcess(PROCESS procIndex) {
+  std::lock_guard<std::mutex> guard(stdOptMutex);
   if (completeMap.find(procIndex) == completeMap.end()) return false;
   return completeMap.find(procIndex)->second;
 }
 
+char *StringDuplicate(const char *str) {
+  return str ? strdup(str) : nullptr;
+}
+
+void FreeString(char *buffer) {
+  free(buffer);
+}
+
 } // namespace CrossProcess
 
 #if defined(_WIN32)
@@ -33,10 +33,14 @@
 #include <CoreGraphics/CoreGraphics.h>
 #include <CoreFoundation/CoreFoundation.h>
 #elif (defined(__linux__) && !defined(__ANDROID__)) || (defined(__FreeBSD__) || defined(__DragonFly__)) || defined(XPROCESS_XQUARTZ_IMPL)
+#if defined(XPROCESS_XCB_IMPL)
+#include <xcb/xcb.h>
+#else
 #include <X11/Xlib.h>
 #endif
 #endif
 #endif
+#endif
 
 namespace CrossProcess {
 
@@ -52,12 +56,35 @@ typedef HWND WINDOW;
 #elif (defined(__APPLE__) && defined(__MACH__)) && !defined(XPROCESS_XQUARTZ_IMPL)
 typedef CGWindowID WINDOW;
 #elif (defined(__linux__) && !defined(__ANDROID__)) || (defined(__FreeBSD__) || defined(__DragonFly__)) || defined(XPROCESS_XQUARTZ_IMPL)
+#if defined(XPROCESS_XCB_IMPL)
+typedef xcb_window_t WINDOW;
+#else
 typedef Window WINDOW;
 #endif
+#endif
 typedef char *WINDOWID;
 #endif
+/* handles can be made, used and freed on any thread, each handle by one
+thread at a time; a const char * result stays valid until that thread's
+next call, arrays returned through pointers are owned by the caller */
 typedef int PROCLIST;
 typedef int PROCINFO;
+typedef int PROCSNAPSHOT;
+typedef int PROCWATCHER;
+/* a chunk of a child's stdout, valid only during the call; output is
+nullptr and length 0 once, after the last chunk, when the child is done */
+typedef void (*PROCOUTPUTCALLBACK)(PROCESS procIndex, const char *output, int length, void *userData);
+/* what a PROCINFO holds, each read the first time it is asked for */
+enum PROCINFO_FIELD {
+  PROCINFO_EXE      = 1 << 0,
+  PROCINFO_CWD      = 1 << 1,
+  PROCINFO_PARENT   = 1 << 2,
+  PROCINFO_CHILDREN = 1 << 3,
+  PROCINFO_CMDLINE  = 1 << 4,
+  PROCINFO_ENVIRON  = 1 << 5,
+  PROCINFO_WINDOWS  = 1 << 6,
+  PROCINFO_ALL      = (1 << 7) - 1
+};
 #if !defined(_MSC_VER)
 #pragma pack(push, 8)
 #else
@@ -110,11 +137,28 @@ void FreeEnviron(char **buffer);
 void EnvironFromProcId(PROCID procId, char ***buffer, int *size);
 void EnvironFromProcIdEx(PROCID procId, const char *name, char **value);
 PROCINFO ProcInfoFromProcId(PROCID procId);
+PROCINFO ProcInfoFromProcIdEx(PROCID procId, int fields);
+void ProcInfoLoad(PROCINFO *procInfo, int size, int fields, int threads);
 void FreeProcInfo(PROCINFO procInfo);
 PROCLIST ProcListCreate();
 PROCID ProcessId(PROCLIST procList, int i);
 int ProcessIdLength(PROCLIST procList);
 void FreeProcList(PROCINFO procInfo);
+PROCSNAPSHOT ProcessSnapshotCreate();
+int ProcessSnapshotLength(PROCSNAPSHOT procSnapshot);
+PROCID ProcessSnapshotProcId(PROCSNAPSHOT procSnapshot, int i);
+PROCID ProcessSnapshotParentProcId(PROCSNAPSHOT procSnapshot, PROCID procId);
+const char *ProcessSnapshotExe(PROCSNAPSHOT procSnapshot, PROCID procId);
+void ProcessSnapshotChildren(PROCSNAPSHOT procSnapshot, PROCID parentProcId, PROCID **procId, int *size);
+void ProcessSnapshotDescendants(PROCSNAPSHOT procSnapshot, PROCID parentProcId, PROCID **procId, int *size);
+void ProcessSnapshotAncestors(PROCSNAPSHOT procSnapshot, PROCID procId, PROCID **parentProcId, int *size);
+void FreeProcessSnapshot(PROCSNAPSHOT procSnapshot);
+PROCWATCHER ProcessWatcherCreate();
+bool ProcessWatcherAdd(PROCWATCHER procWatcher, PROCID procId);
+void ProcessWatcherRemove(PROCWATCHER procWatcher, PROCID procId);
+PROCID ProcessWatcherWait(PROCWATCHER procWatcher, int timeout);
+void FreeProcessWatcher(PROCWATCHER procWatcher);
+bool ProcIdWaitForExit(PROCID procId, int timeout);
 #if defined(XPROCESS_GUIWINDOW_IMPL)
 WINDOWID WindowIdFromNativeWindow(WINDOW window);
 WINDOW NativeWindowFromWindowId(WINDOWID winid);
@@ -146,11 +190,67 @@ int OwnedWindowIdLength(PROCINFO procInfo);
 
 PROCESS ProcessExecute(const char *command);
 PROCESS ProcessExecuteAsync(const char *command);
+PROCESS ProcessExecuteStreaming(const char *command, PROCOUTPUTCALLBACK callback, void *userData);
 void ExecutedProcessWriteToStandardInput(PROCESS procIndex, const char *input);
 const char *ExecutedProcessReadFromStandardOutput(PROCESS procIndex);
+/* closes the child's stdin, so it reads end of file, as soon as no write
+to it is in progress; it is closed anyway once the child is done */
 void FreeExecutedProcessStandardInput(PROCESS procIndex);
 void FreeExecutedProcessStandardOutput(PROCESS procIndex);
 bool CompletionStatusFromExecutedProcess(PROCESS procIndex);
 
+/* a copy of a const char * result the caller owns, to keep it past the
+thread's next call, which may reuse the buffer; nullptr stays nullptr */
+char *StringDuplicate(const char *str);
+void FreeString(char *buffer);
+
+/* owns a handle or array from the functions above and frees it on going
+out of scope; move only, so it has exactly one owner. Out() frees what
+is held and hands out the slot, for results returned through a pointer:
+  UNIQUE_CMDLINE cmdline; int size = 0;
+  CmdlineFromProcId(procId, cmdline.Out(), &size);
+NONE is what holds nothing, -1 for the int handles, which count from 0 */
+template <typename T, void (*FREE)(T), T NONE>
+class UNIQUE {
+ public:
+  UNIQUE() : value(NONE) { }
+  explicit UNIQUE(T value) : value(value) { }
+  UNIQUE(UNIQUE &&other) : value(other.Release()) { }
+  UNIQUE &operator=(UNIQUE &&other) {
+    if (this != &other) Reset(other.Release());
+    return *this;
+  }
+  UNIQUE(const UNIQUE &) = delete;
+  UNIQUE &operator=(const UNIQUE &) = delete;
+  ~UNIQUE() { Reset(NONE); }
+  T Get() const { return value; }
+  T Release() {
+    T result = value; value = NONE;
+    return result;
+  }
+  void Reset(T replacement) {
+    T previous = value; value = replacement;
+    if (previous != NONE) FREE(previous);
+  }
+  T *Out() {
+    Reset(NONE);
+    return &value;
+  }
+ private:
+  T value;
+};
+
+typedef UNIQUE<char *, FreeString, nullptr> UNIQUE_STRING;
+typedef UNIQUE<PROCID *, FreeProcId, nullptr> UNIQUE_PROCID;
+typedef UNIQUE<char **, FreeCmdline, nullptr> UNIQUE_CMDLINE;
+typedef UNIQUE<char **, FreeEnviron, nullptr> UNIQUE_ENVIRON;
+typedef UNIQUE<PROCINFO, FreeProcInfo, -1> UNIQUE_PROCINFO;
+typedef UNIQUE<PROCLIST, FreeProcList, -1> UNIQUE_PROCLIST;
+typedef UNIQUE<PROCSNAPSHOT, FreeProcessSnapshot, -1> UNIQUE_PROCSNAPSHOT;
+typedef UNIQUE<PROCWATCHER, FreeProcessWatcher, -1> UNIQUE_PROCWATCHER;
+#if defined(XPROCESS_GUIWINDOW_IMPL)
+typedef UNIQUE<WINDOWID *, FreeWindowId, nullptr> UNIQUE_WINDOWID;
+#endif
+
 } // namespace CrossProcess
 
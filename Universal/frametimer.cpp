@@ -0,0 +1,99 @@
+/*
+
+ MIT License
+
+ Copyright © 2021 Samuel Venable
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+*/
+
+
+#include <algorithm>
+#include <chrono>
+
+#include <cstddef>
+#include <cmath>
+
+#include "frametimer.h"
+
+namespace {
+
+const int CAPACITY = 512;
+
+double samples[CAPACITY][FrameTimer::PHASE_COUNT];
+double current[FrameTimer::PHASE_COUNT];
+double started[FrameTimer::PHASE_COUNT];
+double lastFrameEnd = -1;
+int    head  = 0;
+int    count = 0;
+
+} // anonymous namespace
+
+namespace FrameTimer {
+
+double Now() {
+  using namespace std::chrono;
+  return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+void PhaseBegin(PHASE phase) {
+  if (phase >= PHASE_GPU) return;
+  started[phase] = Now();
+}
+
+void PhaseEnd(PHASE phase) {
+  if (phase >= PHASE_GPU) return;
+  current[phase] += Now() - started[phase];
+}
+
+void FrameEnd(double gpuMilliseconds) {
+  double now = Now();
+  current[PHASE_GPU] = gpuMilliseconds;
+  current[PHASE_FRAME] = (lastFrameEnd < 0) ? -1 : now - lastFrameEnd;
+  lastFrameEnd = now;
+  std::copy(current, current + PHASE_COUNT, samples[head]);
+  std::fill(current, current + PHASE_COUNT, 0);
+  head = (head + 1) % CAPACITY;
+  count = std::min(count + 1, CAPACITY);
+}
+
+const char *PhaseName(PHASE phase) {
+  static const char *names[PHASE_COUNT] = {
+    "input", "update", "draw", "swap", "gpu", "frame"
+  };
+  return (phase >= 0 && phase < PHASE_COUNT) ? names[phase] : "";
+}
+
+int SampleCount() {
+  return count;
+}
+
+double Percentile(PHASE phase, double p) {
+  double values[CAPACITY]; int n = 0;
+  for (int i = 0; i < count; i++) {
+    if (samples[i][phase] >= 0) values[n++] = samples[i][phase];
+  }
+  if (!n) return 0;
+  int k = (int)std::lround(std::fmin(std::fmax(p, 0), 100) / 100 * (n - 1));
+  std::nth_element(values, values + k, values + n);
+  return values[k];
+}
+
+} // namespace FrameTimer
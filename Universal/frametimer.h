@@ -0,0 +1,65 @@
+/*
+
+ MIT License
+
+ Copyright © 2021 Samuel Venable
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+*/
+
+
+/* per frame cpu timings kept in a fixed ring buffer, cheap enough to leave
+on in release builds; nothing here touches gl, the viewer feeds gpu times
+in from its own timer queries */
+
+namespace FrameTimer {
+
+enum PHASE {
+  PHASE_INPUT,
+  PHASE_UPDATE,
+  PHASE_DRAW,
+  PHASE_SWAP,
+  PHASE_GPU,
+  PHASE_FRAME,
+  PHASE_COUNT
+};
+
+/* milliseconds on a monotonic clock with an arbitrary origin */
+double Now();
+
+/* PhaseBegin() and PhaseEnd() accumulate into the frame being built, so a
+phase may be entered several times per frame; only the first four phases
+are timed this way */
+void PhaseBegin(PHASE phase);
+void PhaseEnd(PHASE phase);
+
+/* closes the frame being built and pushes it into the ring, PHASE_FRAME is
+the interval since the previous call; pass a negative gpuMilliseconds when
+no timer query result is available */
+void FrameEnd(double gpuMilliseconds);
+
+const char *PhaseName(PHASE phase);
+int SampleCount();
+
+/* p is in [0, 100], returns milliseconds over the samples in the ring and
+skips frames without a value for that phase */
+double Percentile(PHASE phase, double p);
+
+} // namespace FrameTimer
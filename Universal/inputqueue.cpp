@@ -0,0 +1,64 @@
+/*
+
+ MIT License
+
+ Copyright © 2021 Samuel Venable
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+*/
+
+#include <atomic>
+
+#include <cstddef>
+
+#include "inputqueue.h"
+
+namespace {
+
+// power of two, so the free running indices can be masked
+const unsigned CAPACITY = 256;
+
+InputQueue::EVENT events[CAPACITY];
+// each index is written by one side only; acquire/release pairs publish
+// the slot contents along with the index
+std::atomic<unsigned> head(0);
+std::atomic<unsigned> tail(0);
+
+} // anonymous namespace
+
+namespace InputQueue {
+
+bool Push(const EVENT *event) {
+  unsigned t = tail.load(std::memory_order_relaxed);
+  if (t - head.load(std::memory_order_acquire) == CAPACITY) return false;
+  events[t & (CAPACITY - 1)] = *event;
+  tail.store(t + 1, std::memory_order_release);
+  return true;
+}
+
+bool Pop(EVENT *event) {
+  unsigned h = head.load(std::memory_order_relaxed);
+  if (h == tail.load(std::memory_order_acquire)) return false;
+  *event = events[h & (CAPACITY - 1)];
+  head.store(h + 1, std::memory_order_release);
+  return true;
+}
+
+} // namespace InputQueue
@@ -0,0 +1,46 @@
+/*
+
+ MIT License
+
+ Copyright © 2021 Samuel Venable
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+*/
+
+/* single producer, single consumer queue of timestamped pointer motion, so
+the viewer can sample input on its own thread and the render thread can
+take it without locking; times are FrameTimer::Now() milliseconds */
+
+namespace InputQueue {
+
+typedef struct {
+  double Time;
+  double DeltaX;
+  double DeltaY;
+} EVENT;
+
+/* producer thread only, returns false when the queue is full; nothing is
+overwritten, so the caller should hold on to the event and retry */
+bool Push(const EVENT *event);
+
+/* consumer thread only, returns false when the queue is empty */
+bool Pop(EVENT *event);
+
+} // namespace InputQueue
@@ -0,0 +1,139 @@
+/*
+
+ MIT License
+
+ Copyright © 2021 Samuel Venable
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+*/
+
+#include <fstream>
+#include <sstream>
+
+#include <cstddef>
+#include <cmath>
+
+#include "softrender.h"
+#include "overlay.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OVERLAY_SSE2
+#endif
+
+namespace {
+
+typedef struct {
+  float F[3], R[3], U[3];
+  float KX, KY;                   // |R|^2 and |U|^2 scaled by 1 + margin
+  float RR, UU;                   // |R|^2 and |U|^2
+} FRUSTUM;
+
+void Keep(const FRUSTUM *f, float x, float y, float z, float icon, std::vector<float> *visible) {
+  float dz = x * f->F[0] + y * f->F[1] + z * f->F[2];
+  float dr = x * f->R[0] + y * f->R[1] + z * f->R[2];
+  float du = x * f->U[0] + y * f->U[1] + z * f->U[2];
+  visible->push_back(dr / (dz * f->RR));
+  visible->push_back(du / (dz * f->UU));
+  visible->push_back(icon);
+}
+
+bool Inside(const FRUSTUM *f, float x, float y, float z) {
+  float dz = x * f->F[0] + y * f->F[1] + z * f->F[2];
+  float dr = x * f->R[0] + y * f->R[1] + z * f->R[2];
+  float du = x * f->U[0] + y * f->U[1] + z * f->U[2];
+  // |ndc| <= 1 + margin without dividing, dz > 0 keeps markers behind out
+  return dz > 0 && std::fabs(dr) <= dz * f->KX && std::fabs(du) <= dz * f->KY;
+}
+
+} // anonymous namespace
+
+namespace Overlay {
+
+bool LoadMarkers(const char *fname, MARKERS *markers) {
+  std::ifstream file(fname);
+  if (!file) return false;
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream sstr(line);
+    std::string name; float x, y, icon;
+    if (!(sstr >> name) || name[0] == '#' || !(sstr >> x >> y >> icon)) continue;
+    markers->Name.push_back(name);
+    markers->TexX.push_back(x); markers->TexY.push_back(y);
+    markers->Icon.push_back(icon);
+  }
+  markers->PlacedWidth = markers->PlacedHeight = -1;
+  return true;
+}
+
+void Place(MARKERS *markers, const SoftRender::TEXTURE *texture) {
+  if (markers->PlacedWidth == texture->Width && markers->PlacedHeight == texture->Height) return;
+  size_t count = markers->Name.size();
+  markers->X.resize(count); markers->Y.resize(count); markers->Z.resize(count);
+  for (size_t i = 0; i < count && texture->Width && texture->Height; i++) {
+    double direction[3];
+    SoftRender::DirectionFromTexCoord(texture, markers->TexX[i] / texture->Width,
+      1 - markers->TexY[i] / texture->Height, direction);
+    markers->X[i] = (float)direction[0];
+    markers->Y[i] = (float)direction[1];
+    markers->Z[i] = (float)direction[2];
+  }
+  markers->PlacedWidth = texture->Width; markers->PlacedHeight = texture->Height;
+}
+
+int Cull(const MARKERS *markers, const SoftRender::CAMERA *camera, float marginx, float marginy,
+  std::vector<float> *visible) {
+  FRUSTUM f;
+  for (int i = 0; i < 3; i++) {
+    f.F[i] = (float)camera->Forward[i]; f.R[i] = (float)camera->Right[i]; f.U[i] = (float)camera->Up[i];
+  }
+  f.RR = f.R[0] * f.R[0] + f.R[1] * f.R[1] + f.R[2] * f.R[2];
+  f.UU = f.U[0] * f.U[0] + f.U[1] * f.U[1] + f.U[2] * f.U[2];
+  f.KX = f.RR * (1 + marginx); f.KY = f.UU * (1 + marginy);
+  size_t count = markers->X.size(), i = 0; size_t before = visible->size();
+  const float *X = markers->X.data(), *Y = markers->Y.data(), *Z = markers->Z.data();
+  #if defined(OVERLAY_SSE2)
+  const __m128 f0 = _mm_set1_ps(f.F[0]), f1 = _mm_set1_ps(f.F[1]), f2 = _mm_set1_ps(f.F[2]);
+  const __m128 r0 = _mm_set1_ps(f.R[0]), r1 = _mm_set1_ps(f.R[1]), r2 = _mm_set1_ps(f.R[2]);
+  const __m128 u0 = _mm_set1_ps(f.U[0]), u1 = _mm_set1_ps(f.U[1]), u2 = _mm_set1_ps(f.U[2]);
+  const __m128 kx = _mm_set1_ps(f.KX), ky = _mm_set1_ps(f.KY), zero = _mm_setzero_ps();
+  const __m128 abs = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+  for (; i + 4 <= count; i += 4) {
+    __m128 x = _mm_loadu_ps(X + i), y = _mm_loadu_ps(Y + i), z = _mm_loadu_ps(Z + i);
+    __m128 dz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, f0), _mm_mul_ps(y, f1)), _mm_mul_ps(z, f2));
+    __m128 dr = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, r0), _mm_mul_ps(y, r1)), _mm_mul_ps(z, r2));
+    __m128 du = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, u0), _mm_mul_ps(y, u1)), _mm_mul_ps(z, u2));
+    __m128 inside = _mm_and_ps(_mm_cmpgt_ps(dz, zero),
+      _mm_and_ps(_mm_cmple_ps(_mm_and_ps(dr, abs), _mm_mul_ps(dz, kx)),
+      _mm_cmple_ps(_mm_and_ps(du, abs), _mm_mul_ps(dz, ky))));
+    // most of a panorama is out of view at any time, so whole groups usually drop here
+    int mask = _mm_movemask_ps(inside);
+    for (int lane = 0; mask; lane++, mask >>= 1) {
+      if (mask & 1) Keep(&f, X[i + lane], Y[i + lane], Z[i + lane], markers->Icon[i + lane], visible);
+    }
+  }
+  #endif
+  for (; i < count; i++) {
+    if (Inside(&f, X[i], Y[i], Z[i])) Keep(&f, X[i], Y[i], Z[i], markers->Icon[i], visible);
+  }
+  return (int)((visible->size() - before) / 3);
+}
+
+} // namespace Overlay
@@ -0,0 +1,62 @@
+/*
+
+ MIT License
+
+ Copyright © 2021 Samuel Venable
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+*/
+
+/* markers pinned to the panorama: loading, placing them on the prism and
+culling them against the view; drawing is left to the viewer, which
+gets back one packed array of what survived, ready for a single draw.
+Include softrender.h ahead of this header */
+
+#include <string>
+#include <vector>
+
+namespace Overlay {
+
+/* structure of arrays, so culling can take four markers at once */
+typedef struct {
+  std::vector<std::string> Name;
+  std::vector<float> TexX, TexY;   // as loaded, texels in the png's orientation
+  std::vector<float> Icon;         // cell in the icon atlas, left to right
+  std::vector<float> X, Y, Z;      // object space, filled in by Place()
+  double PlacedWidth, PlacedHeight;
+} MARKERS;
+
+/* one marker per line, blank lines and lines starting with # skipped:
+  name x y icon
+returns false if the file can't be read, malformed lines are ignored */
+bool LoadMarkers(const char *fname, MARKERS *markers);
+
+/* puts every marker on the prism wall for the texture's size; cheap to call
+every frame, it only does work when the size changed since last time */
+void Place(MARKERS *markers, const SoftRender::TEXTURE *texture);
+
+/* keeps markers in front of camera whose projection lands within the view
+widened by margin x and y in normalized device coordinates (so an icon
+straddling the edge is kept), appending ndc x, ndc y, icon for each to
+visible; returns how many were kept */
+int Cull(const MARKERS *markers, const SoftRender::CAMERA *camera, float marginx, float marginy,
+  std::vector<float> *visible);
+
+} // namespace Overlay
@@ -0,0 +1,230 @@
+/*
+
+ MIT License
+
+ Copyright © 2021 Samuel Venable
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+*/
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include <cmath>
+
+#include "softrender.h"
+#include "picking.h"
+
+namespace {
+
+void Bounds(Picking::HOTSPOT *hotspot) {
+  if (hotspot->Polygon.size() < 6) return;
+  hotspot->Left = hotspot->Right = hotspot->Polygon[0];
+  hotspot->Top = hotspot->Bottom = hotspot->Polygon[1];
+  for (size_t i = 2; i + 1 < hotspot->Polygon.size(); i += 2) {
+    hotspot->Left   = std::min(hotspot->Left,   hotspot->Polygon[i]);
+    hotspot->Right  = std::max(hotspot->Right,  hotspot->Polygon[i]);
+    hotspot->Top    = std::min(hotspot->Top,    hotspot->Polygon[i + 1]);
+    hotspot->Bottom = std::max(hotspot->Bottom, hotspot->Polygon[i + 1]);
+  }
+}
+
+// even-odd rule
+bool PolygonContains(const std::vector<double> &polygon, double x, double y) {
+  bool inside = false; size_t n = polygon.size() / 2;
+  for (size_t i = 0, j = n - 1; i < n; j = i++) {
+    double xi = polygon[i * 2], yi = polygon[i * 2 + 1];
+    double xj = polygon[j * 2], yj = polygon[j * 2 + 1];
+    if ((yi > y) != (yj > y) && x < (xj - xi) * (y - yi) / (yj - yi) + xi)
+      inside = !inside;
+  }
+  return inside;
+}
+
+bool Contains(const Picking::HOTSPOT *hotspot, double x, double y) {
+  if (x < hotspot->Left || x >= hotspot->Right || y < hotspot->Top || y >= hotspot->Bottom)
+    return false;
+  return hotspot->Polygon.empty() || PolygonContains(hotspot->Polygon, x, y);
+}
+
+int Clamp(int value, int low, int high) {
+  return std::min(std::max(value, low), high);
+}
+
+// entries a node holds before it is split, and how often it may be
+const size_t NODE_CAPACITY = 8;
+const int NODE_DEPTH = 12;
+
+bool Overlaps(const Picking::HOTSPOT *hotspot, double left, double top, double right, double bottom, double texwidth) {
+  if (hotspot->Top >= bottom || hotspot->Bottom <= top) return false;
+  for (int k = -1; k <= 1; k++) {
+    if (hotspot->Left + k * texwidth < right && hotspot->Right + k * texwidth > left) return true;
+  }
+  return false;
+}
+
+/* a split pays only when it separates hotspots, shapes that all cover
+the node would be copied into every quarter, so it must leave each
+quarter with at most three quarters of the entries */
+void Split(Picking::INDEX *index, size_t node, double left, double top, double width, double height, int depth) {
+  if (index->Nodes[node].Hotspots.size() <= NODE_CAPACITY || depth >= NODE_DEPTH) return;
+  const std::vector<int> &entries = index->Nodes[node].Hotspots;
+  double w = width / 2, h = height / 2;
+  std::vector<int> quarters[4];
+  for (int q = 0; q < 4; q++) {
+    double l = left + (q & 1) * w, t = top + (q >> 1) * h;
+    for (size_t i = 0; i < entries.size(); i++) {
+      if (Overlaps(&index->Hotspots[entries[i]], l, t, l + w, t + h, index->TexWidth))
+        quarters[q].push_back(entries[i]);
+    }
+    if (quarters[q].size() * 4 > entries.size() * 3) return;
+  }
+  int first = (int)index->Nodes.size();
+  index->Nodes.resize(index->Nodes.size() + 4);
+  index->Nodes[node].Children = first;
+  std::vector<int>().swap(index->Nodes[node].Hotspots);
+  for (int q = 0; q < 4; q++) {
+    index->Nodes[first + q].Hotspots.swap(quarters[q]);
+    index->Nodes[first + q].Children = -1;
+  }
+  for (int q = 0; q < 4; q++)
+    Split(index, first + q, left + (q & 1) * w, top + (q >> 1) * h, w, h, depth + 1);
+}
+
+} // anonymous namespace
+
+namespace Picking {
+
+bool TexelFromScreen(const SoftRender::TEXTURE *texture, const SoftRender::CAMERA *camera,
+  double x, double y, int width, int height, double *texx, double *texy) {
+  *texx = 0; *texy = 0;
+  if (width <= 0 || height <= 0) return false;
+  double ndcx = 2 * (x + 0.5) / width - 1;
+  double ndcy = 1 - 2 * (y + 0.5) / height;
+  const double *F = camera->Forward, *R = camera->Right, *U = camera->Up;
+  double direction[3] = {
+    F[0] + ndcy * U[0] + ndcx * R[0],
+    F[1] + ndcy * U[1] + ndcx * R[1],
+    F[2] + ndcy * U[2] + ndcx * R[2]
+  };
+  double s, t;
+  if (!SoftRender::TexCoordFromDirection(texture, direction, &s, &t)) return false;
+  // the texture is uploaded bottom row first, so t runs up the image
+  *texx = std::min(std::max(s, 0.0), 1.0) * texture->Width;
+  *texy = (1 - std::min(std::max(t, 0.0), 1.0)) * texture->Height;
+  return true;
+}
+
+void TexelsFromScreen(const SoftRender::TEXTURE *texture, const SoftRender::CAMERA *camera,
+  const double *screen, int count, int width, int height, double *texels, bool *hits) {
+  for (int i = 0; i < count; i++) {
+    bool hit = TexelFromScreen(texture, camera, screen[i * 2], screen[i * 2 + 1],
+      width, height, &texels[i * 2], &texels[i * 2 + 1]);
+    if (hits) hits[i] = hit;
+  }
+}
+
+bool LoadHotspots(const char *fname, std::vector<HOTSPOT> *hotspots) {
+  std::ifstream file(fname);
+  if (!file) return false;
+  std::string line;
+  while (std::getline(file, line)) {
+    std::istringstream sstr(line);
+    HOTSPOT hotspot; std::string shape;
+    if (!(sstr >> hotspot.Name) || hotspot.Name[0] == '#' || !(sstr >> shape)) continue;
+    if (shape == "rect") {
+      if (!(sstr >> hotspot.Left >> hotspot.Top >> hotspot.Right >> hotspot.Bottom)) continue;
+      if (hotspot.Right < hotspot.Left) std::swap(hotspot.Left, hotspot.Right);
+      if (hotspot.Bottom < hotspot.Top) std::swap(hotspot.Top, hotspot.Bottom);
+    } else if (shape == "poly") {
+      double value;
+      while (sstr >> value) hotspot.Polygon.push_back(value);
+      if (hotspot.Polygon.size() < 6 || hotspot.Polygon.size() % 2) continue;
+      Bounds(&hotspot);
+    } else {
+      continue;
+    }
+    hotspots->push_back(hotspot);
+  }
+  return true;
+}
+
+void IndexBuild(INDEX *index, const std::vector<HOTSPOT> &hotspots, double texwidth, double texheight) {
+  index->Hotspots = hotspots;
+  index->TexWidth = std::max(texwidth, 1.0); index->TexHeight = std::max(texheight, 1.0);
+  // about one hotspot per cell on average, in cells about as square as the texture allows
+  double cells = std::max(1.0, (double)hotspots.size());
+  double aspect = index->TexWidth / index->TexHeight;
+  index->Columns = Clamp((int)std::ceil(std::sqrt(cells * aspect)), 1, 1024);
+  index->Rows = Clamp((int)std::ceil(cells / index->Columns), 1, 1024);
+  index->CellWidth = index->TexWidth / index->Columns;
+  index->CellHeight = index->TexHeight / index->Rows;
+  NODE leaf; leaf.Children = -1;
+  index->Nodes.assign((size_t)index->Columns * index->Rows, leaf);
+  for (size_t i = 0; i < index->Hotspots.size(); i++) {
+    HOTSPOT *hotspot = &index->Hotspots[i];
+    int r0 = Clamp((int)std::floor(hotspot->Top / index->CellHeight), 0, index->Rows - 1);
+    int r1 = Clamp((int)std::floor(hotspot->Bottom / index->CellHeight), 0, index->Rows - 1);
+    // columns wrap, a shape past the right edge continues on the left
+    int c0 = (int)std::floor(hotspot->Left / index->CellWidth);
+    int c1 = (int)std::floor(hotspot->Right / index->CellWidth);
+    if (c1 - c0 >= index->Columns) { c0 = 0; c1 = index->Columns - 1; }
+    for (int r = r0; r <= r1; r++) {
+      for (int c = c0; c <= c1; c++) {
+        int column = ((c % index->Columns) + index->Columns) % index->Columns;
+        index->Nodes[(size_t)r * index->Columns + column].Hotspots.push_back((int)i);
+      }
+    }
+  }
+  for (int r = 0; r < index->Rows; r++) {
+    for (int c = 0; c < index->Columns; c++) {
+      Split(index, (size_t)r * index->Columns + c, c * index->CellWidth, r * index->CellHeight,
+        index->CellWidth, index->CellHeight, 0);
+    }
+  }
+}
+
+int IndexQuery(const INDEX *index, double texx, double texy) {
+  if (index->Nodes.empty() || texy < 0 || texy >= index->TexHeight) return -1;
+  texx = std::fmod(std::fmod(texx, index->TexWidth) + index->TexWidth, index->TexWidth);
+  int column = Clamp((int)(texx / index->CellWidth), 0, index->Columns - 1);
+  int row = Clamp((int)(texy / index->CellHeight), 0, index->Rows - 1);
+  size_t node = (size_t)row * index->Columns + column;
+  double left = column * index->CellWidth, top = row * index->CellHeight;
+  double width = index->CellWidth, height = index->CellHeight;
+  while (index->Nodes[node].Children != -1) {
+    width /= 2; height /= 2;
+    int q = (texx >= left + width ? 1 : 0) + (texy >= top + height ? 2 : 0);
+    if (q & 1) left += width;
+    if (q & 2) top += height;
+    node = index->Nodes[node].Children + q;
+  }
+  const std::vector<int> &cell = index->Nodes[node].Hotspots;
+  // leaves list hotspots in file order, so search from the back
+  for (size_t i = cell.size(); i-- > 0;) {
+    const HOTSPOT *hotspot = &index->Hotspots[cell[i]];
+    if (Contains(hotspot, texx, texy) || Contains(hotspot, texx + index->TexWidth, texy) ||
+      Contains(hotspot, texx - index->TexWidth, texy)) return cell[i];
+  }
+  return -1;
+}
+
+} // namespace Picking
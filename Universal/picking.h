@@ -0,0 +1,85 @@
+/*
+
+ MIT License
+
+ Copyright © 2021 Samuel Venable
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+*/
+
+/* screen to panorama picking through the same inverse projection the
+software renderer uses, plus a uniform grid of hotspots so hit tests
+stay cheap with thousands of them; texel coordinates are in the png's
+own orientation, x to the right and y down from its top row; include
+softrender.h ahead of this header */
+
+#include <string>
+#include <vector>
+
+namespace Picking {
+
+/* texel under pixel (x, y) of a width by height window showing camera,
+pixel centers at +0.5 exactly as SoftRender::RenderPanorama() samples */
+bool TexelFromScreen(const SoftRender::TEXTURE *texture, const SoftRender::CAMERA *camera,
+  double x, double y, int width, int height, double *texx, double *texy);
+
+/* count points, screen holds x, y pairs and texels receives them likewise;
+hits may be nullptr, otherwise it gets whether each point picked anything */
+void TexelsFromScreen(const SoftRender::TEXTURE *texture, const SoftRender::CAMERA *camera,
+  const double *screen, int count, int width, int height, double *texels, bool *hits);
+
+/* a rectangle, or a polygon when Polygon holds x, y pairs, in texels; a
+shape may run past the right edge to wrap around the seam */
+typedef struct {
+  std::string Name;
+  double Left, Top, Right, Bottom;
+  std::vector<double> Polygon;
+} HOTSPOT;
+
+/* a grid cell, or a quarter of one; Children is the first of four
+quarters in reading order, -1 for a leaf, which lists its hotspots */
+typedef struct {
+  std::vector<int> Hotspots;
+  int Children;
+} NODE;
+
+/* the first Columns * Rows nodes are the grid, a cell that collects
+more hotspots than a few, where they cluster, is split into quarters */
+typedef struct {
+  std::vector<HOTSPOT> Hotspots;
+  std::vector<NODE> Nodes;
+  int Columns, Rows;
+  double CellWidth, CellHeight;
+  double TexWidth, TexHeight;
+} INDEX;
+
+/* one hotspot per line, blank lines and lines starting with # skipped:
+  name rect left top right bottom
+  name poly x1 y1 x2 y2 x3 y3 ...
+returns false if the file can't be read, malformed lines are ignored */
+bool LoadHotspots(const char *fname, std::vector<HOTSPOT> *hotspots);
+
+void IndexBuild(INDEX *index, const std::vector<HOTSPOT> &hotspots, double texwidth, double texheight);
+
+/* index into index->Hotspots of the hotspot at a texel, -1 for none; where
+hotspots overlap the one listed last wins, as it would be drawn on top */
+int IndexQuery(const INDEX *index, double texx, double texy);
+
+} // namespace Picking
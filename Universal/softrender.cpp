@@ -0,0 +1,336 @@
+/*
+
+ MIT License
+
+ Copyright © 2021 Samuel Venable
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+
+#include "softrender.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SOFTRENDER_SSE2
+#endif
+
+namespace {
+
+const double PI = 3.141592653589793;
+
+/* DrawPanorama() steps around the cylinder 0.3141592653589793 radians at a
+time, so what the GPU draws is really a 20 sided prism; match that rather
+than a true cylinder or the two renders drift apart between the vertices */
+const int    SEGMENTS   = 20;
+const double RESOLUTION = 2 * PI / SEGMENTS;
+const double RADIUS     = 100;
+const int    TILESIZE   = 64;
+
+double Apothem() {
+  return RADIUS * std::cos(RESOLUTION / 2);
+}
+
+/* position along a prism face, 0 at its first vertex and 1 at its last,
+for a ray whose angle sits beta radians off the face's mid angle */
+double ChordCoordFromAngle(double beta) {
+  return 0.5 + 0.5 * std::tan(beta) / std::tan(RESOLUTION / 2);
+}
+
+void Rotate(const double in[3], double xangle, double yangle, double out[3]) {
+  // undo glRotatef(yangle, 1, 0, 0), then glRotatef(xangle + 90, 0, 91, 0)
+  double ya = yangle * PI / 180, xa = (xangle + 90) * PI / 180;
+  double wx = in[0];
+  double wy = in[1] * std::cos(ya) + in[2] * std::sin(ya);
+  double wz = in[2] * std::cos(ya) - in[1] * std::sin(ya);
+  out[0] = wx * std::cos(xa) - wz * std::sin(xa);
+  out[1] = wy;
+  out[2] = wx * std::sin(xa) + wz * std::cos(xa);
+}
+
+#if defined(SOFTRENDER_SSE2)
+inline __m128 Atan2Approx(__m128 y, __m128 x) {
+  // minimax atan() on [0, 1], worst error is well below a texel at 64k wide
+  const __m128 sign = _mm_set1_ps(-0.0f);
+  __m128 ax = _mm_andnot_ps(sign, x), ay = _mm_andnot_ps(sign, y);
+  __m128 swap = _mm_cmpgt_ps(ay, ax);
+  __m128 num = _mm_or_ps(_mm_and_ps(swap, ax), _mm_andnot_ps(swap, ay));
+  __m128 den = _mm_or_ps(_mm_and_ps(swap, ay), _mm_andnot_ps(swap, ax));
+  __m128 z = _mm_div_ps(num, _mm_max_ps(den, _mm_set1_ps(1e-30f)));
+  __m128 z2 = _mm_mul_ps(z, z);
+  __m128 p = _mm_set1_ps(-0.0117212f);
+  p = _mm_add_ps(_mm_mul_ps(p, z2), _mm_set1_ps(0.05265332f));
+  p = _mm_add_ps(_mm_mul_ps(p, z2), _mm_set1_ps(-0.11643287f));
+  p = _mm_add_ps(_mm_mul_ps(p, z2), _mm_set1_ps(0.19354346f));
+  p = _mm_add_ps(_mm_mul_ps(p, z2), _mm_set1_ps(-0.33262347f));
+  p = _mm_add_ps(_mm_mul_ps(p, z2), _mm_set1_ps(0.99997726f));
+  __m128 r = _mm_mul_ps(p, z);
+  __m128 halfpi = _mm_set1_ps((float)(PI / 2));
+  r = _mm_or_ps(_mm_and_ps(swap, _mm_sub_ps(halfpi, r)), _mm_andnot_ps(swap, r));
+  __m128 neg = _mm_cmplt_ps(x, _mm_setzero_ps());
+  r = _mm_or_ps(_mm_and_ps(neg, _mm_sub_ps(_mm_set1_ps((float)PI), r)), _mm_andnot_ps(neg, r));
+  return _mm_or_ps(r, _mm_and_ps(sign, y));
+}
+
+/* texture coordinates for four rays at once; lanes whose ray leaves the
+prism through a cap come back with t outside [0, 1] for the scalar path */
+inline void TexCoordFromDirection4(__m128 dx, __m128 dy, __m128 dz, float height,
+  __m128 *s, __m128 *t) {
+  const __m128 twopi = _mm_set1_ps((float)(2 * PI));
+  __m128 phi = Atan2Approx(dz, dx);
+  phi = _mm_add_ps(phi, _mm_and_ps(_mm_cmplt_ps(phi, _mm_setzero_ps()), twopi));
+  __m128 q = _mm_mul_ps(phi, _mm_set1_ps((float)(SEGMENTS / (2 * PI))));
+  __m128 k = _mm_cvtepi32_ps(_mm_cvttps_epi32(q));
+  k = _mm_min_ps(k, _mm_set1_ps((float)(SEGMENTS - 1)));
+  __m128 beta = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(q, k), _mm_set1_ps(0.5f)),
+    _mm_set1_ps((float)RESOLUTION));
+  __m128 b2 = _mm_mul_ps(beta, beta);
+  // |beta| <= pi / 20 so short series are exact to float precision
+  __m128 tanb = _mm_add_ps(_mm_mul_ps(b2, _mm_set1_ps(2.0f / 15)), _mm_set1_ps(1.0f / 3));
+  tanb = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(tanb, b2), _mm_set1_ps(1)), beta);
+  __m128 cosb = _mm_add_ps(_mm_mul_ps(b2, _mm_set1_ps(1.0f / 24)), _mm_set1_ps(-0.5f));
+  cosb = _mm_add_ps(_mm_mul_ps(cosb, b2), _mm_set1_ps(1));
+  __m128 u = _mm_add_ps(_mm_set1_ps(0.5f), _mm_mul_ps(tanb,
+    _mm_set1_ps((float)(0.5 / std::tan(RESOLUTION / 2)))));
+  *s = _mm_mul_ps(_mm_add_ps(k, u), _mm_set1_ps(1.0f / SEGMENTS));
+  __m128 hlen = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dz, dz)));
+  __m128 dist = _mm_div_ps(_mm_set1_ps((float)Apothem()), _mm_mul_ps(cosb, hlen));
+  __m128 y = _mm_add_ps(_mm_set1_ps(height / 2), _mm_mul_ps(dy, dist));
+  *t = _mm_mul_ps(y, _mm_set1_ps(1 / height));
+}
+#endif
+
+/* texture coordinates for a run of at most TILESIZE ray directions, four
+at a time where SSE2 is available */
+void TexCoordsFromDirections(const SoftRender::TEXTURE *texture, const float *dx,
+  const float *dy, const float *dz, unsigned n, float *S, float *T) {
+  unsigned i = 0;
+  #if defined(SOFTRENDER_SSE2)
+  float cyl = (float)SoftRender::CylinderHeight(texture);
+  for (; i + 4 <= n; i += 4) {
+    __m128 s, t;
+    TexCoordFromDirection4(_mm_loadu_ps(dx + i), _mm_loadu_ps(dy + i),
+      _mm_loadu_ps(dz + i), cyl, &s, &t);
+    _mm_storeu_ps(S + i, s);
+    _mm_storeu_ps(T + i, t);
+    for (unsigned j = i; j < i + 4; j++) {
+      if (T[j] >= 0 && T[j] <= 1) continue;
+      double dir[3] = { dx[j], dy[j], dz[j] }, ss = 0, tt = 0;
+      SoftRender::TexCoordFromDirection(texture, dir, &ss, &tt);
+      S[j] = (float)ss; T[j] = (float)tt;
+    }
+  }
+  #endif
+  for (; i < n; i++) {
+    double dir[3] = { dx[i], dy[i], dz[i] }, s = 0, t = 0;
+    SoftRender::TexCoordFromDirection(texture, dir, &s, &t);
+    S[i] = (float)s; T[i] = (float)t;
+  }
+}
+
+/* fills one row of a tile given a direction for each of its pixels */
+void ShadeRun(const SoftRender::TEXTURE *texture, SoftRender::FILTER filter,
+  const float *dx, const float *dy, const float *dz, unsigned n, unsigned char *dst) {
+  float S[TILESIZE], T[TILESIZE];
+  TexCoordsFromDirections(texture, dx, dy, dz, n, S, T);
+  for (unsigned i = 0; i < n; i++, dst += 4) {
+    SoftRender::SampleTexture(texture, S[i], T[i], filter, dst);
+  }
+}
+
+void RenderTile(const SoftRender::TEXTURE *texture, const SoftRender::CAMERA *camera,
+  unsigned char *out, unsigned width, unsigned height, SoftRender::FILTER filter,
+  unsigned x0, unsigned y0, unsigned x1, unsigned y1) {
+  float DX[TILESIZE], DY[TILESIZE], DZ[TILESIZE];
+  const double *F = camera->Forward, *R = camera->Right, *U = camera->Up;
+  for (unsigned y = y0; y < y1; y++) {
+    double ndcy = 1 - 2 * (y + 0.5) / height;
+    for (unsigned x = x0; x < x1; x++) {
+      double ndcx = 2 * (x + 0.5) / width - 1;
+      DX[x - x0] = (float)(F[0] + ndcy * U[0] + ndcx * R[0]);
+      DY[x - x0] = (float)(F[1] + ndcy * U[1] + ndcx * R[1]);
+      DZ[x - x0] = (float)(F[2] + ndcy * U[2] + ndcx * R[2]);
+    }
+    ShadeRun(texture, filter, DX, DY, DZ, x1 - x0, out + ((std::size_t)y * width + x0) * 4);
+  }
+}
+
+void RenderEquirectangularTile(const SoftRender::TEXTURE *texture, unsigned char *out,
+  unsigned width, unsigned height, SoftRender::FILTER filter,
+  unsigned x0, unsigned y0, unsigned x1, unsigned y1) {
+  float DX[TILESIZE], DY[TILESIZE], DZ[TILESIZE], C[TILESIZE], S[TILESIZE];
+  for (unsigned x = x0; x < x1; x++) {
+    // longitude 0 is what the viewer shows at an xangle of 0
+    double lon = 2 * PI * (x + 0.5) / width;
+    C[x - x0] = (float)std::cos(lon);
+    S[x - x0] = (float)std::sin(lon);
+  }
+  for (unsigned y = y0; y < y1; y++) {
+    double lat = PI / 2 - PI * (y + 0.5) / height;
+    float cl = (float)std::cos(lat), sl = (float)std::sin(lat);
+    for (unsigned x = x0; x < x1; x++) {
+      DX[x - x0] = cl * C[x - x0];
+      DY[x - x0] = sl;
+      DZ[x - x0] = cl * S[x - x0];
+    }
+    ShadeRun(texture, filter, DX, DY, DZ, x1 - x0, out + ((std::size_t)y * width + x0) * 4);
+  }
+}
+
+/* splits the output into tiles that worker threads pull from a counter */
+template<typename TileFunc>
+void ForEachTile(unsigned width, unsigned height, int threads, TileFunc func) {
+  unsigned tilesx = (width + TILESIZE - 1) / TILESIZE;
+  unsigned tilesy = (height + TILESIZE - 1) / TILESIZE;
+  unsigned tiles = tilesx * tilesy;
+  if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+  threads = (int)std::min((unsigned)threads, tiles);
+  std::atomic<unsigned> next(0);
+  auto worker = [&]() {
+    unsigned i;
+    while ((i = next.fetch_add(1)) < tiles) {
+      unsigned x0 = (i % tilesx) * TILESIZE, y0 = (i / tilesx) * TILESIZE;
+      func(x0, y0, std::min(x0 + TILESIZE, width), std::min(y0 + TILESIZE, height));
+    }
+  };
+  std::vector<std::thread> pool;
+  for (int i = 1; i < threads; i++)
+    pool.emplace_back(worker);
+  worker();
+  for (std::size_t i = 0; i < pool.size(); i++)
+    pool[i].join();
+}
+
+} // anonymous namespace
+
+namespace SoftRender {
+
+double CylinderHeight(const TEXTURE *texture) {
+  // same clamp timer() applies to AspectRatio before every frame
+  double aspect = (double)texture->Width / (double)texture->Height;
+  aspect = std::fmin(std::fmax(aspect, 0.1), 6);
+  return 700 / aspect;
+}
+
+void CameraFromAngles(double xangle, double yangle, double fovy, double aspect, CAMERA *camera) {
+  double f = std::tan(fovy * PI / 360);
+  double forward[3] = { 0, 0, -1 };
+  double right[3]   = { f * aspect, 0, 0 };
+  double up[3]      = { 0, f, 0 };
+  Rotate(forward, xangle, yangle, camera->Forward);
+  Rotate(right,   xangle, yangle, camera->Right);
+  Rotate(up,      xangle, yangle, camera->Up);
+}
+
+bool TexCoordFromDirection(const TEXTURE *texture, const double direction[3], double *s, double *t) {
+  *s = 0; *t = 0;
+  double dx = direction[0], dy = direction[1], dz = direction[2];
+  double hlen = std::sqrt(dx * dx + dz * dz);
+  if (hlen == 0 && dy == 0) return false;
+  double height = CylinderHeight(texture);
+  double phi = std::atan2(dz, dx); if (phi < 0) phi += 2 * PI;
+  int k = std::min((int)(phi / RESOLUTION), SEGMENTS - 1);
+  double mid = (k + 0.5) * RESOLUTION;
+  if (hlen > 0) {
+    double beta = phi - mid;
+    double y = height / 2 + dy * Apothem() / (std::cos(beta) * hlen);
+    if (y >= 0 && y <= height) {
+      *s = (k + ChordCoordFromAngle(beta)) / SEGMENTS;
+      *t = y / height;
+      return true;
+    }
+  }
+  // the caps are triangle fans around the axis with a planar disk mapping
+  double dist = (height / 2) / std::fabs(dy);
+  double px = dx * dist, pz = dz * dist;
+  *s = 0.5 + 0.5 * px / RADIUS;
+  *t = 0.5 + 0.5 * pz / RADIUS;
+  if (dy > 0) {
+    // the top fan's center vertex has texcoord (0.5, 1) rather than (0.5, 0.5)
+    double centre = 1 - (px * std::cos(mid) + pz * std::sin(mid)) / Apothem();
+    *t += 0.5 * std::fmax(centre, 0);
+  }
+  return true;
+}
+
+void DirectionFromTexCoord(const TEXTURE *texture, double s, double t, double direction[3]) {
+  double height = CylinderHeight(texture);
+  s = std::fmod(std::fmod(s, 1.0) + 1, 1.0);
+  int k = std::min((int)(s * SEGMENTS), SEGMENTS - 1);
+  // faces are flat, so the point moves linearly between their vertices
+  double f = s * SEGMENTS - k, a0 = k * RESOLUTION, a1 = (k + 1) * RESOLUTION;
+  direction[0] = RADIUS * ((1 - f) * std::cos(a0) + f * std::cos(a1));
+  direction[1] = t * height - height / 2;
+  direction[2] = RADIUS * ((1 - f) * std::sin(a0) + f * std::sin(a1));
+}
+
+void SampleTexture(const TEXTURE *texture, double s, double t, FILTER filter, unsigned char *rgba) {
+  const unsigned char *px = texture->Pixels;
+  int w = (int)texture->Width, h = (int)texture->Height;
+  if (!px || w <= 0 || h <= 0) { rgba[0] = rgba[1] = rgba[2] = 0; rgba[3] = 255; return; }
+  if (filter == FILTER_NEAREST) {
+    int x = std::min(std::max((int)std::floor(s * w), 0), w - 1);
+    int y = std::min(std::max((int)std::floor(t * h), 0), h - 1);
+    const unsigned char *src = px + ((std::size_t)y * w + x) * 4;
+    rgba[0] = src[0]; rgba[1] = src[1]; rgba[2] = src[2]; rgba[3] = src[3];
+    return;
+  }
+  double fx = s * w - 0.5, fy = t * h - 0.5;
+  double flx = std::floor(fx), fly = std::floor(fy);
+  // 8 bit fixed point weights keep the blend in integer arithmetic
+  unsigned wx = (unsigned)((fx - flx) * 256), wy = (unsigned)((fy - fly) * 256);
+  int x0 = std::min(std::max((int)flx, 0), w - 1), x1 = std::min(std::max((int)flx + 1, 0), w - 1);
+  int y0 = std::min(std::max((int)fly, 0), h - 1), y1 = std::min(std::max((int)fly + 1, 0), h - 1);
+  const unsigned char *a = px + ((std::size_t)y0 * w + x0) * 4;
+  const unsigned char *b = px + ((std::size_t)y0 * w + x1) * 4;
+  const unsigned char *c = px + ((std::size_t)y1 * w + x0) * 4;
+  const unsigned char *d = px + ((std::size_t)y1 * w + x1) * 4;
+  for (int i = 0; i < 4; i++) {
+    unsigned top = a[i] * (256 - wx) + b[i] * wx;
+    unsigned bot = c[i] * (256 - wx) + d[i] * wx;
+    rgba[i] = (unsigned char)((top * (256 - wy) + bot * wy + 32768) >> 16);
+  }
+}
+
+void RenderPanorama(const TEXTURE *texture, const CAMERA *camera, unsigned char *out,
+  unsigned width, unsigned height, FILTER filter, int threads) {
+  if (!out || !width || !height) return;
+  ForEachTile(width, height, threads, [&](unsigned x0, unsigned y0, unsigned x1, unsigned y1) {
+    RenderTile(texture, camera, out, width, height, filter, x0, y0, x1, y1);
+  });
+}
+
+void RenderEquirectangular(const TEXTURE *texture, unsigned char *out,
+  unsigned width, unsigned height, FILTER filter, int threads) {
+  if (!out || !width || !height) return;
+  ForEachTile(width, height, threads, [&](unsigned x0, unsigned y0, unsigned x1, unsigned y1) {
+    RenderEquirectangularTile(texture, out, width, height, filter, x0, y0, x1, y1);
+  });
+}
+
+} // namespace SoftRender
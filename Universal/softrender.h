@@ -0,0 +1,83 @@
+/*
+
+ MIT License
+
+ Copyright © 2021 Samuel Venable
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+*/
+
+/* software (no GPU) reprojection of a cylindrical panorama, producing
+the same view as the immediate mode DrawPanorama() in panoview.cpp */
+
+namespace SoftRender {
+
+enum FILTER {
+  FILTER_NEAREST,
+  FILTER_BILINEAR
+};
+
+/* Pixels is RGBA, flipped bottom row first exactly like the buffer that
+LoadImage() hands to glTexImage2D(); Width and Height are in texels */
+typedef struct {
+  const unsigned char *Pixels;
+  unsigned Width;
+  unsigned Height;
+} TEXTURE;
+
+/* pinhole camera in panorama object space, the ray for a pixel at
+normalized device coordinates (x, y) is Forward + x * Right + y * Up */
+typedef struct {
+  double Forward[3];
+  double Right[3];
+  double Up[3];
+} CAMERA;
+
+/* cylinder height DrawPanorama() uses for a texture, radius is always 100 */
+double CylinderHeight(const TEXTURE *texture);
+
+/* same view transform as DisplayGraphics(), note that the viewer passes
+gluPerspective() an aspect of 4 / 3, which is integer division, hence 1 */
+void CameraFromAngles(double xangle, double yangle, double fovy, double aspect, CAMERA *camera);
+
+/* maps an object space direction to a texture coordinate, returns false
+for a zero length direction; directions through the caps map as the
+triangle fans in DrawPanorama() do */
+bool TexCoordFromDirection(const TEXTURE *texture, const double direction[3], double *s, double *t);
+
+/* the other way around for the prism's wall: the object space point a
+texture coordinate is drawn at, with the origin on the axis halfway up
+like the directions above; t outside [0, 1] carries on past the caps */
+void DirectionFromTexCoord(const TEXTURE *texture, double s, double t, double direction[3]);
+
+/* samples one RGBA texel with GL_CLAMP_TO_EDGE semantics */
+void SampleTexture(const TEXTURE *texture, double s, double t, FILTER filter, unsigned char *rgba);
+
+/* out is RGBA, width * height * 4 bytes, top row first (PNG order, the
+opposite of glReadPixels()); threads <= 0 uses every hardware thread */
+void RenderPanorama(const TEXTURE *texture, const CAMERA *camera, unsigned char *out,
+  unsigned width, unsigned height, FILTER filter, int threads);
+
+/* full sphere, longitude 0 to 360 left to right starting where an xangle
+of 0 looks, latitude 90 to -90 top to bottom; same out and threads rules */
+void RenderEquirectangular(const TEXTURE *texture, unsigned char *out,
+  unsigned width, unsigned height, FILTER filter, int threads);
+
+} // namespace SoftRender
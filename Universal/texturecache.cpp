@@ -0,0 +1,388 @@
+/*
+
+ MIT License
+
+ Copyright © 2021 Samuel Venable
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+*/
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <chrono>
+
+#include <cstdint>
+#include <cerrno>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <climits>
+#endif
+
+#include "texturecache.h"
+
+namespace {
+
+const std::uint32_t MAGIC = 0x70616e6f; // "pano"
+
+enum STATUS {
+  STATUS_DECODING,
+  STATUS_READY,
+  STATUS_FAILED,
+  STATUS_ABANDONED                // the publisher died, the name is unlinked
+};
+
+/* lives at the start of the segment, the pixels follow it; every field is
+written once by the publishing process before Status becomes READY,
+except References, which counts the processes mapping the segment and
+is only relied on where the segment can't be locked */
+typedef struct {
+  std::uint32_t Magic;
+  std::uint32_t Width;
+  std::uint32_t Height;
+  std::atomic<int> Status;
+  std::atomic<int> References;
+} HEADER;
+
+// round up so the pixels stay 16 byte aligned for the sse paths
+const size_t HEADER_SIZE = (sizeof(HEADER) + 15) & ~(size_t)15;
+
+/* how long to wait on a publisher that is alive but slow, or one that
+died where there's no lock to tell us so */
+const int PUBLISH_TIMEOUT = 30000;
+
+std::chrono::steady_clock::time_point PublishDeadline() {
+  return std::chrono::steady_clock::now() + std::chrono::milliseconds(PUBLISH_TIMEOUT);
+}
+
+/* the publisher holds a lock the kernel drops if it dies: flock(LOCK_EX)
+on the segment, downgraded to the LOCK_SH every mapping process holds,
+or on windows a named mutex, which a dead owner leaves abandoned */
+typedef struct {
+  HEADER *Header;
+  size_t Size;
+  std::string Name;
+  #if defined(_WIN32)
+  HANDLE Mapping;
+  HANDLE Lock;
+  #else
+  int Fd;
+  bool Locked;                    // false where shm can't be flock()ed (bsd, macos)
+  #endif
+} SEGMENT;
+
+/* width and height straight from the IHDR chunk, which a valid png must
+have first, so the segment can be sized before anything is decoded */
+bool PngDimensions(const char *fname, unsigned *width, unsigned *height) {
+  unsigned char buffer[24];
+  FILE *file = fopen(fname, "rb");
+  if (!file) return false;
+  size_t nRead = fread(buffer, 1, sizeof(buffer), file);
+  fclose(file);
+  static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+  if (nRead != sizeof(buffer) || memcmp(buffer, signature, 8) != 0 ||
+    memcmp(buffer + 12, "IHDR", 4) != 0) return false;
+  *width  = ((unsigned)buffer[16] << 24) | (buffer[17] << 16) | (buffer[18] << 8) | buffer[19];
+  *height = ((unsigned)buffer[20] << 24) | (buffer[21] << 16) | (buffer[22] << 8) | buffer[23];
+  return *width && *height;
+}
+
+/* fnv-1a over the full path, size and mtime, so an edited file or another
+file at the same path gets its own segment */
+bool SegmentName(const char *fname, std::string *name) {
+  std::uint64_t hash = 14695981039346656037ull;
+  std::string key;
+  #if defined(_WIN32)
+  char path[MAX_PATH]; WIN32_FILE_ATTRIBUTE_DATA attributes;
+  if (!_fullpath(path, fname, MAX_PATH)) return false;
+  if (!GetFileAttributesExA(path, GetFileExInfoStandard, &attributes)) return false;
+  key = std::string(path) + "|" + std::to_string(attributes.nFileSizeLow) + "|" +
+    std::to_string(attributes.nFileSizeHigh) + "|" + std::to_string(attributes.ftLastWriteTime.dwLowDateTime) +
+    "|" + std::to_string(attributes.ftLastWriteTime.dwHighDateTime);
+  #else
+  char path[PATH_MAX]; struct stat info;
+  if (!realpath(fname, path) || stat(path, &info) != 0) return false;
+  key = std::string(path) + "|" + std::to_string((long long)info.st_size) + "|" +
+    std::to_string((long long)info.st_mtime);
+  #endif
+  for (size_t i = 0; i < key.length(); i++) {
+    hash ^= (unsigned char)key[i];
+    hash *= 1099511628211ull;
+  }
+  char buffer[32]; snprintf(buffer, sizeof(buffer), "%016llx", (unsigned long long)hash);
+  #if defined(_WIN32)
+  *name = std::string("Local\\panoview-") + buffer;
+  #else
+  // 31 characters at most for macOS
+  *name = std::string("/panoview-") + buffer;
+  #endif
+  return true;
+}
+
+#if !defined(_WIN32)
+/* unlinks the name only if it still refers to the segment fd has open,
+someone may already have replaced a stale one under the same name */
+void SegmentUnlink(int fd, const std::string &name) {
+  int current = shm_open(name.c_str(), O_RDONLY, 0600);
+  if (current == -1) return;
+  struct stat mine, theirs;
+  bool same = (fstat(fd, &mine) == 0 && fstat(current, &theirs) == 0 &&
+    mine.st_dev == theirs.st_dev && mine.st_ino == theirs.st_ino);
+  close(current);
+  if (same) shm_unlink(name.c_str());
+}
+#endif
+
+#if defined(__linux__)
+/* segments left behind by viewers that were killed: one we can take
+LOCK_EX on is mapped by nobody, and one that's sized isn't a creator
+still starting up; only linux lets us list them, under /dev/shm */
+void SegmentSweep() {
+  DIR *dir = opendir("/dev/shm");
+  if (!dir) return;
+  while (dirent *entry = readdir(dir)) {
+    if (strncmp(entry->d_name, "panoview-", 9) != 0) continue;
+    std::string name = std::string("/") + entry->d_name;
+    int fd = shm_open(name.c_str(), O_RDWR, 0600);
+    if (fd == -1) continue;
+    struct stat info;
+    if (flock(fd, LOCK_EX | LOCK_NB) == 0 && fstat(fd, &info) == 0 && info.st_size > 0)
+      SegmentUnlink(fd, name);
+    close(fd);
+  }
+  closedir(dir);
+}
+#endif
+
+/* opens or creates the segment, *created tells the caller it must publish;
+a creator comes back holding the publish lock */
+bool SegmentOpen(SEGMENT *segment, bool *created) {
+  #if defined(_WIN32)
+  segment->Mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+    (DWORD)((unsigned long long)segment->Size >> 32), (DWORD)(segment->Size & 0xffffffff),
+    segment->Name.c_str());
+  if (!segment->Mapping) return false;
+  // the kernel counts the handles, so References is only kept for symmetry
+  *created = (GetLastError() != ERROR_ALREADY_EXISTS);
+  segment->Lock = CreateMutexA(nullptr, FALSE, (segment->Name + "-lock").c_str());
+  if (!segment->Lock) { CloseHandle(segment->Mapping); return false; }
+  void *address = MapViewOfFile(segment->Mapping, FILE_MAP_ALL_ACCESS, 0, 0, segment->Size);
+  if (!address) { CloseHandle(segment->Lock); CloseHandle(segment->Mapping); return false; }
+  segment->Header = (HEADER *)address;
+  if (*created) WaitForSingleObject(segment->Lock, INFINITE);
+  #else
+  *created = true;
+  int fd = shm_open(segment->Name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd == -1 && errno == EEXIST) {
+    *created = false;
+    fd = shm_open(segment->Name.c_str(), O_RDWR, 0600);
+  }
+  if (fd == -1) return false;
+  if (*created) {
+    // locked before it's sized, so a sized segment always has its lock taken
+    segment->Locked = (flock(fd, LOCK_EX) == 0);
+    if (ftruncate(fd, segment->Size) != 0) { close(fd); shm_unlink(segment->Name.c_str()); return false; }
+  } else {
+    /* a shared lock means the publisher is done or dead; a segment that
+    isn't sized yet means the creator hasn't got as far as locking it */
+    struct stat info; bool unlocked = true;
+    std::chrono::steady_clock::time_point deadline = PublishDeadline();
+    segment->Locked = true;
+    for (;;) {
+      unlocked = true;
+      if (segment->Locked && flock(fd, LOCK_SH | LOCK_NB) != 0) {
+        if (errno == EWOULDBLOCK) unlocked = false; else segment->Locked = false;
+      }
+      if (unlocked) {
+        if (fstat(fd, &info) == 0 && (size_t)info.st_size >= segment->Size) break;
+        if (segment->Locked) flock(fd, LOCK_UN);
+      }
+      if (std::chrono::steady_clock::now() >= deadline) {
+        // a publisher still holding LOCK_EX is alive, only slow, so it keeps the name
+        if (unlocked) SegmentUnlink(fd, segment->Name);
+        close(fd); return false;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+  void *address = mmap(nullptr, segment->Size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (address == MAP_FAILED) {
+    if (*created) shm_unlink(segment->Name.c_str());
+    close(fd);
+    return false;
+  }
+  // kept open for as long as it's mapped, the lock goes with it
+  segment->Fd = fd;
+  segment->Header = (HEADER *)address;
+  #endif
+  return true;
+}
+
+/* the publisher is done with the pixels, others may read them now */
+void SegmentPublished(SEGMENT *segment) {
+  #if defined(_WIN32)
+  ReleaseMutex(segment->Lock);
+  #else
+  if (segment->Locked) flock(segment->Fd, LOCK_SH);
+  #endif
+}
+
+/* waits out the publisher and returns the status it left; STATUS_DECODING
+means it died before it was done, on windows the caller then holds the
+abandoned mutex and should publish in its place, elsewhere the name has
+been unlinked and the caller should start over with a fresh segment */
+int SegmentWait(SEGMENT *segment) {
+  HEADER *header = segment->Header;
+  #if defined(_WIN32)
+  std::chrono::steady_clock::time_point deadline = PublishDeadline();
+  while (std::chrono::steady_clock::now() < deadline) {
+    DWORD result = WaitForSingleObject(segment->Lock, PUBLISH_TIMEOUT);
+    if (result != WAIT_OBJECT_0 && result != WAIT_ABANDONED) break;
+    int status = header->Status.load(std::memory_order_acquire);
+    if (status != STATUS_DECODING) { ReleaseMutex(segment->Lock); return status; }
+    if (result == WAIT_ABANDONED) return STATUS_DECODING;
+    // the creator hasn't taken the mutex yet
+    ReleaseMutex(segment->Lock);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return STATUS_FAILED;
+  #else
+  int status = header->Status.load(std::memory_order_acquire);
+  if (segment->Locked) {
+    if (status == STATUS_ABANDONED) return STATUS_DECODING;
+    if (status != STATUS_DECODING) return status;
+    // our shared lock says nobody is decoding, so the publisher died; one
+    // process gets to mark it abandoned and unlink, everyone starts over
+    if (header->Status.compare_exchange_strong(status, STATUS_ABANDONED))
+      SegmentUnlink(segment->Fd, segment->Name);
+    return STATUS_DECODING;
+  }
+  std::chrono::steady_clock::time_point deadline = PublishDeadline();
+  while (status == STATUS_DECODING && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    status = header->Status.load(std::memory_order_acquire);
+  }
+  if (status == STATUS_DECODING) { SegmentUnlink(segment->Fd, segment->Name); return STATUS_FAILED; }
+  return status;
+  #endif
+}
+
+void SegmentClose(SEGMENT *segment, bool unlink) {
+  #if defined(_WIN32)
+  UnmapViewOfFile(segment->Header);
+  CloseHandle(segment->Lock);
+  CloseHandle(segment->Mapping);
+  #else
+  munmap(segment->Header, segment->Size);
+  if (unlink) SegmentUnlink(segment->Fd, segment->Name);
+  close(segment->Fd);
+  #endif
+  delete segment;
+}
+
+/* drops this process's reference, unlinking the segment with the last;
+where it's locked that's whoever can take LOCK_EX, so a count left
+behind by a process that died doesn't keep the segment around */
+void SegmentRelease(SEGMENT *segment) {
+  bool last = (segment->Header->References.fetch_sub(1) == 1);
+  #if !defined(_WIN32)
+  if (segment->Locked) last = (flock(segment->Fd, LOCK_EX | LOCK_NB) == 0);
+  #endif
+  SegmentClose(segment, last);
+}
+
+} // anonymous namespace
+
+namespace TextureCache {
+
+bool Acquire(const char *fname, DECODER decode, IMAGE *image) {
+  image->Pixels = nullptr; image->Width = 0; image->Height = 0; image->Segment = nullptr;
+  unsigned width = 0, height = 0; std::string name;
+  if (!PngDimensions(fname, &width, &height) || !SegmentName(fname, &name)) return false;
+  #if defined(__linux__)
+  static std::once_flag swept;
+  std::call_once(swept, SegmentSweep);
+  #endif
+  // more goes are for starting over after a publisher that died, the
+  // last one in case the name wasn't unlinked yet on the one before
+  for (int attempt = 0; attempt < 3; attempt++) {
+    SEGMENT *segment = new SEGMENT();
+    segment->Name = name;
+    segment->Size = HEADER_SIZE + (size_t)width * height * 4;
+    bool created = false;
+    if (!SegmentOpen(segment, &created)) { delete segment; return false; }
+    HEADER *header = segment->Header;
+    // count with fetch_add as someone may have mapped it the moment it was sized
+    header->References.fetch_add(1);
+    if (!created) {
+      int status = SegmentWait(segment);
+      #if defined(_WIN32)
+      // the segment lives on through our handle, so publish into it ourselves
+      created = (status == STATUS_DECODING);
+      #else
+      if (status == STATUS_DECODING) { header->References.fetch_sub(1); SegmentClose(segment, false); continue; }
+      #endif
+      if (!created && (status != STATUS_READY || header->Magic != MAGIC ||
+        header->Width != width || header->Height != height)) {
+        SegmentRelease(segment);
+        return false;
+      }
+    }
+    if (created) {
+      // a fresh segment is zero filled, which reads as STATUS_DECODING
+      unsigned char *data = nullptr; unsigned w = 0, h = 0;
+      bool decoded = (decode(fname, &data, &w, &h) == 0 && data && w == width && h == height);
+      if (decoded) {
+        memcpy((unsigned char *)header + HEADER_SIZE, data, (size_t)width * height * 4);
+        header->Magic = MAGIC; header->Width = width; header->Height = height;
+      }
+      delete[] data;
+      header->Status.store(decoded ? STATUS_READY : STATUS_FAILED, std::memory_order_release);
+      SegmentPublished(segment);
+      if (!decoded) { SegmentClose(segment, true); return false; }
+    }
+    image->Pixels = (const unsigned char *)header + HEADER_SIZE;
+    image->Width = width; image->Height = height;
+    image->Segment = segment;
+    return true;
+  }
+  return false;
+}
+
+void Release(IMAGE *image) {
+  if (!image->Segment) return;
+  SegmentRelease((SEGMENT *)image->Segment);
+  image->Pixels = nullptr; image->Width = 0; image->Height = 0; image->Segment = nullptr;
+}
+
+} // namespace TextureCache
@@ -0,0 +1,52 @@
+/*
+
+ MIT License
+
+ Copyright © 2021 Samuel Venable
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+*/
+
+/* decoded panoramas shared between panoview processes through named
+shared memory, keyed on the file's full path, size and modification
+time; the first process to ask decodes, everyone after maps its pixels */
+
+namespace TextureCache {
+
+typedef struct {
+  const unsigned char *Pixels;    // exactly what the decoder produced, RGBA
+  unsigned Width;
+  unsigned Height;
+  void *Segment;                  // owned by TextureCache, nullptr when empty
+} IMAGE;
+
+/* same contract as LoadImage(): *out is allocated with new[] and left
+alone on failure, a nonzero return means failure */
+typedef unsigned (*DECODER)(const char *fname, unsigned char **out, unsigned *width, unsigned *height);
+
+/* maps the shared copy of fname, calling decode to publish it first if no
+process has yet; false for anything other than a png, or when shared
+memory can't be had, in which case the caller should decode privately */
+bool Acquire(const char *fname, DECODER decode, IMAGE *image);
+
+/* drops this process's reference; the segment goes away with the last */
+void Release(IMAGE *image);
+
+} // namespace TextureCache
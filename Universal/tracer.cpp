@@ -0,0 +1,198 @@
+/*
+
+ MIT License
+
+ Copyright © 2021 Samuel Venable
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+*/
+
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+
+#include <cstdlib>
+#include <cstddef>
+#include <cstdio>
+#include <csignal>
+
+#include "tracer.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+typedef struct {
+  const char *name;
+  double begin;
+  double duration;
+  int thread;
+} EVENT;
+
+// about 32 MB of events, enough for hours of frames before we stop recording
+const std::size_t CAPACITY = 1 << 20;
+
+std::atomic<bool>   enabled(false);
+std::atomic<int>    threadCount(0);
+std::mutex          eventMutex;
+std::mutex          writeMutex;
+std::vector<EVENT>  events;
+std::size_t         dropped = 0;
+std::string         path;
+
+volatile std::sig_atomic_t dumpRequested = 0;
+volatile std::sig_atomic_t exitRequested = 0;
+
+#if defined(_WIN32)
+std::wstring widen(std::string str) {
+  std::size_t wchar_count = str.size() + 1;
+  std::vector<wchar_t> buf(wchar_count);
+  return std::wstring { buf.data(), (std::size_t)MultiByteToWideChar(CP_UTF8, 0, str.c_str(), -1, buf.data(), (int)wchar_count) };
+}
+#endif
+
+int ThreadId() {
+  thread_local int id = ++threadCount;
+  return id;
+}
+
+int ProcessId() {
+  #if defined(_WIN32)
+  return (int)GetCurrentProcessId();
+  #else
+  return (int)getpid();
+  #endif
+}
+
+void SignalHandler(int sig) {
+  #if defined(SIGUSR1)
+  if (sig == SIGUSR1) { dumpRequested = 1; return; }
+  #endif
+  // a second signal while the first is still pending gets the default action
+  if (exitRequested) { std::signal(sig, SIG_DFL); std::raise(sig); return; }
+  exitRequested = sig;
+}
+
+/* the file is truncated and written whole, so two writers at once, the
+watcher and the atexit handler say, would leave a mess; writeMutex held */
+bool WriteFile() {
+  std::vector<EVENT> copy; std::size_t lost = 0;
+  {
+    std::lock_guard<std::mutex> guard(eventMutex);
+    copy = events; lost = dropped;
+  }
+  #if defined(_WIN32)
+  FILE *file = _wfopen(widen(path).c_str(), L"wb");
+  #else
+  FILE *file = fopen(path.c_str(), "wb");
+  #endif
+  if (!file) return false;
+  int pid = ProcessId();
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"dropped\":%zu},\"traceEvents\":[\n", lost);
+  fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":1,\"args\":{\"name\":\"panoview\"}}", pid);
+  for (std::size_t i = 0; i < copy.size(); i++) {
+    fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+    copy[i].name, pid, copy[i].thread, copy[i].begin, copy[i].duration);
+  }
+  fprintf(file, "\n]}\n");
+  return (fclose(file) == 0);
+}
+
+void WriteAtExit() {
+  Tracer::Write();
+}
+
+/* acts on the flags the handler raises from a thread of its own, so a
+signal is answered wherever the main thread happens to be: an export,
+a decode, a blocking dialog, or the GLUT loop; once the trace is out
+the signal is raised again with its default action, so the process ends
+the way it would have untraced and the host sees the signal, and
+writeMutex stays held so an exit racing it can't truncate the file */
+void Watch() {
+  for (;;) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    if (dumpRequested) { dumpRequested = 0; Tracer::Write(); }
+    if (exitRequested) {
+      int sig = exitRequested;
+      writeMutex.lock();
+      WriteFile(); fflush(nullptr);
+      std::signal(sig, SIG_DFL); std::raise(sig);
+      std::_Exit(128 + sig);
+    }
+  }
+}
+
+} // anonymous namespace
+
+namespace Tracer {
+
+bool Start(const char *fname) {
+  if (!fname || !*fname || enabled) return false;
+  path = fname;
+  events.reserve(4096);
+  enabled = true;
+  std::atexit(WriteAtExit);
+  std::signal(SIGINT, SignalHandler);
+  std::signal(SIGTERM, SignalHandler);
+  #if defined(SIGUSR1)
+  std::signal(SIGUSR1, SignalHandler);
+  #endif
+  std::thread(Watch).detach();
+  return true;
+}
+
+bool Enabled() {
+  return enabled;
+}
+
+double Now() {
+  using namespace std::chrono;
+  return duration<double, std::micro>(steady_clock::now().time_since_epoch()).count();
+}
+
+void Complete(const char *name, double begin, double end) {
+  if (!enabled) return;
+  EVENT event = { name, begin, end - begin, ThreadId() };
+  std::lock_guard<std::mutex> guard(eventMutex);
+  if (events.size() < CAPACITY) events.push_back(event);
+  else dropped++;
+}
+
+bool Write() {
+  if (!enabled) return false;
+  std::lock_guard<std::mutex> guard(writeMutex);
+  return WriteFile();
+}
+
+ZONE::ZONE(const char *name) : name(name), begin(enabled ? Now() : 0) { }
+
+ZONE::~ZONE() {
+  if (enabled) Complete(name, begin, Now());
+}
+
+} // namespace Tracer
@@ -0,0 +1,59 @@
+/*
+
+ MIT License
+
+ Copyright © 2021 Samuel Venable
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy
+ of this software and associated documentation files (the "Software"), to deal
+ in the Software without restriction, including without limitation the rights
+ to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ copies of the Software, and to permit persons to whom the Software is
+ furnished to do so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+
+*/
+
+
+/* scoped timing zones written out as chrome trace event json, which loads
+in chrome://tracing and ui.perfetto.dev; recording is off, and a ZONE
+costs one branch, until Start() is called */
+
+namespace Tracer {
+
+/* enables recording to fname, which is written at exit, when SIGUSR1 is
+received, or on SIGINT / SIGTERM, after which the signal takes its
+default action, so the exit status is what it would have been */
+bool Start(const char *fname);
+bool Enabled();
+
+/* microseconds on the clock trace timestamps use */
+double Now();
+
+/* records a zone measured by hand, name must outlive the trace, which
+string literals do */
+void Complete(const char *name, double begin, double end);
+
+/* writes everything recorded so far, may be called any number of times */
+bool Write();
+
+class ZONE {
+ public:
+  ZONE(const char *name);
+  ~ZONE();
+ private:
+  const char *name;
+  double begin;
+};
+
+} // namespace Tracer
@@ -1,10 +1,11 @@
 #!/bin/sh
 cd "${0%/*}"
+if [ "$XCB" = "1" ]; then XCBFLAGS="-DXPROCESS_XCB_IMPL -lxcb"; fi
 
 if [ $(uname) = "Linux" ]; then
-  g++ panoview.cpp Universal/crossprocess.cpp Unix/lodepng.cpp xlib/dlgmodule.cpp -DFREEGLUT_GLES=ON -o panoview -std=c++17 -static-libgcc -static-libstdc++ -lSDL2 -lGL -lGLU -lglut -lm -lpthread -lX11 -lXrandr -lXinerama -lprocps -no-pie -DXPROCESS_GUIWINDOW_IMPL
+  g++ panoview.cpp Universal/crossprocess.cpp Universal/softrender.cpp Universal/frametimer.cpp Universal/tracer.cpp Universal/inputqueue.cpp Universal/camera.cpp Universal/texturecache.cpp Universal/picking.cpp Universal/overlay.cpp Universal/atlas.cpp Unix/lodepng.cpp xlib/dlgmodule.cpp -DFREEGLUT_GLES=ON -o panoview -std=c++17 -static-libgcc -static-libstdc++ -lSDL2 -lGL -lGLU -lglut -lm -lpthread -lrt -lX11 -lXrandr -lXinerama -lXi -no-pie -DXPROCESS_GUIWINDOW_IMPL $XCBFLAGS
 elif [ $(uname) = "FreeBSD" ]; then
-  clang++ panoview.cpp Universal/crossprocess.cpp Unix/lodepng.cpp xlib/dlgmodule.cpp -DFREEGLUT_GLES=ON -o panoview -std=c++17 -I/usr/local/include -L/usr/local/lib -lGL -lGLU -lglut -lm -lpthread -lX11 -lXrandr -lXinerama -lprocstat -lutil -lc -no-pie -DXPROCESS_GUIWINDOW_IMPL
+  clang++ panoview.cpp Universal/crossprocess.cpp Universal/softrender.cpp Universal/frametimer.cpp Universal/tracer.cpp Universal/inputqueue.cpp Universal/camera.cpp Universal/texturecache.cpp Universal/picking.cpp Universal/overlay.cpp Universal/atlas.cpp Unix/lodepng.cpp xlib/dlgmodule.cpp -DFREEGLUT_GLES=ON -o panoview -std=c++17 -I/usr/local/include -L/usr/local/lib -lGL -lGLU -lglut -lm -lpthread -lX11 -lXrandr -lXinerama -lXi -lprocstat -lutil -lc -no-pie -DXPROCESS_GUIWINDOW_IMPL $XCBFLAGS
 elif [ $(uname) = "DragonFly" ]; then
-  g++ panoview.cpp Universal/crossprocess.cpp Unix/lodepng.cpp xlib/dlgmodule.cpp -o -DFREEGLUT_GLES=ON panoview -std=c++17 -I/usr/local/include -L/usr/local/lib -lGL -lGLU -lglut -lm -lpthread -lX11 -lXrandr -lXinerama -lkvm -lutil -lc -no-pie -DXPROCESS_GUIWINDOW_IMPL
+  g++ panoview.cpp Universal/crossprocess.cpp Universal/softrender.cpp Universal/frametimer.cpp Universal/tracer.cpp Universal/inputqueue.cpp Universal/camera.cpp Universal/texturecache.cpp Universal/picking.cpp Universal/overlay.cpp Universal/atlas.cpp Unix/lodepng.cpp xlib/dlgmodule.cpp -o -DFREEGLUT_GLES=ON panoview -std=c++17 -I/usr/local/include -L/usr/local/lib -lGL -lGLU -lglut -lm -lpthread -lX11 -lXrandr -lXinerama -lXi -lkvm -lutil -lc -no-pie -DXPROCESS_GUIWINDOW_IMPL $XCBFLAGS
 fi
@@ -0,0 +1,16 @@
+#!/bin/sh
+cd "${0%/*}"
+COMMIT=$(git rev-parse --short HEAD 2>/dev/null || echo unknown)
+if [ "$XCB" = "1" ]; then XCBFLAGS="-DXPROCESS_XCB_IMPL -lxcb"; fi
+
+if [ $(uname) = "Darwin" ]; then
+  clang++ Benchmark/panoview_bench.cpp Universal/crossprocess.cpp Universal/softrender.cpp Universal/frametimer.cpp Universal/tracer.cpp Universal/inputqueue.cpp Universal/camera.cpp Universal/texturecache.cpp Universal/picking.cpp Universal/overlay.cpp Universal/atlas.cpp Unix/lodepng.cpp MacOSX/objcpp.mm MacOSX/dlgmodule.mm MacOSX/config.cpp -o panoview_bench -std=c++17 -O2 -DPANOVIEW_COMMIT="\"$COMMIT\"" -ObjC++ -framework OpenGL -framework GLUT -framework Cocoa -DGL_SILENCE_DEPRECATION -DXPROCESS_GUIWINDOW_IMPL -m64
+elif [ $(uname) = "Linux" ]; then
+  g++ Benchmark/panoview_bench.cpp Universal/crossprocess.cpp Universal/softrender.cpp Universal/frametimer.cpp Universal/tracer.cpp Universal/inputqueue.cpp Universal/camera.cpp Universal/texturecache.cpp Universal/picking.cpp Universal/overlay.cpp Universal/atlas.cpp Unix/lodepng.cpp xlib/dlgmodule.cpp -o panoview_bench -std=c++17 -O2 -DPANOVIEW_COMMIT="\"$COMMIT\"" -static-libgcc -static-libstdc++ -lGL -lGLU -lglut -lm -lpthread -lrt -lX11 -lXrandr -lXinerama -lXi -no-pie -DXPROCESS_GUIWINDOW_IMPL -m64 $XCBFLAGS
+elif [ $(uname) = "FreeBSD" ]; then
+  clang++ Benchmark/panoview_bench.cpp Universal/crossprocess.cpp Universal/softrender.cpp Universal/frametimer.cpp Universal/tracer.cpp Universal/inputqueue.cpp Universal/camera.cpp Universal/texturecache.cpp Universal/picking.cpp Universal/overlay.cpp Universal/atlas.cpp Unix/lodepng.cpp xlib/dlgmodule.cpp -o panoview_bench -std=c++17 -O2 -DPANOVIEW_COMMIT="\"$COMMIT\"" -I/usr/local/include -L/usr/local/lib -lGL -lGLU -lglut -lm -lpthread -lX11 -lXrandr -lXinerama -lXi -lprocstat -lutil -lc -no-pie -DXPROCESS_GUIWINDOW_IMPL -m64 $XCBFLAGS
+elif [ $(uname) = "DragonFly" ]; then
+  g++ Benchmark/panoview_bench.cpp Universal/crossprocess.cpp Universal/softrender.cpp Universal/frametimer.cpp Universal/tracer.cpp Universal/inputqueue.cpp Universal/camera.cpp Universal/texturecache.cpp Universal/picking.cpp Universal/overlay.cpp Universal/atlas.cpp Unix/lodepng.cpp xlib/dlgmodule.cpp -o panoview_bench -std=c++17 -O2 -DPANOVIEW_COMMIT="\"$COMMIT\"" -I/usr/local/include -L/usr/local/lib -lGL -lGLU -lglut -lm -lpthread -lX11 -lXrandr -lXinerama -lXi -lkvm -lutil -lc -no-pie -DXPROCESS_GUIWINDOW_IMPL -m64 $XCBFLAGS
+else
+  g++ Benchmark/panoview_bench.cpp Universal/crossprocess.cpp Universal/softrender.cpp Universal/frametimer.cpp Universal/tracer.cpp Universal/inputqueue.cpp Universal/camera.cpp Universal/texturecache.cpp Universal/picking.cpp Universal/overlay.cpp Universal/atlas.cpp Win32/libpng-util.cpp Win32/dlgmodule.cpp /c/msys64/mingw64/lib/libpng.a /c/msys64/mingw64/lib/libz.a /c/msys64/mingw64/lib/libfreeglut_static.a -DXPROCESS_WIN32EXE_INCLUDES -DXPROCESS_GUIWINDOW_IMPL -DFREEGLUT_STATIC -o panoview_bench.exe -std=c++17 -O2 -DPANOVIEW_COMMIT="\"$COMMIT\"" -static -I/c/msys64/mingw64/inlcude -L/c/msys64/mingw64/lib -static-libgcc -static-libstdc++ -lmingw32 -lglu32 -lopengl32 -lgdiplus -lgdi32 -lshlwapi -lcomctl32 -lcomdlg32 -lole32 -lwinmm -fPIC -m64
+fi
@@ -27,9 +27,11 @@
 #include <string>
 #include <vector>
 #include <thread>
+#include <atomic>
 #include <chrono>
 #include <sstream>
 #include <algorithm>
+#include <map>
 #include <iostream>
 
 #include <cstdlib>
@@ -42,6 +44,15 @@
 
 #include "Universal/crossprocess.h"
 #include "Universal/dlgmodule.h"
+#include "Universal/softrender.h"
+#include "Universal/frametimer.h"
+#include "Universal/tracer.h"
+#include "Universal/inputqueue.h"
+#include "Universal/camera.h"
+#include "Universal/texturecache.h"
+#include "Universal/picking.h"
+#include "Universal/overlay.h"
+#include "Universal/atlas.h"
 #if defined(_WIN32)
 #include "Win32/libpng-util.h"
 #elif !defined(_WIN32)
@@ -52,16 +63,18 @@
 #include <X11/Xlib.h>
 #include <X11/extensions/Xrandr.h>
 #include <X11/extensions/Xinerama.h>
+#include <X11/extensions/XInput2.h>
 #endif
 #include "Unix/lodepng.h"
 #endif
 
-#if !defined(_WIN32)
 #include <sys/types.h>
 #include <sys/stat.h>
+#if !defined(_WIN32)
 #include <signal.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 #endif
 
 #if (defined(__APPLE__) && defined(__MACH__))
@@ -79,12 +92,29 @@
 #include <GL/glx.h>
 #endif
 #include <GL/glut.h>
+#if defined(FREEGLUT)
+#include <GL/freeglut_ext.h>
+#endif
 #endif
 
 #if defined(_WIN32)
 #define GL_CLAMP_TO_EDGE 0x812F
 #endif
 
+// timer queries are core in 3.3, older headers lack them
+#if !defined(GL_TIME_ELAPSED)
+#define GL_TIME_ELAPSED 0x88BF
+#endif
+#if !defined(GL_QUERY_RESULT)
+#define GL_QUERY_RESULT 0x8866
+#endif
+#if !defined(GL_QUERY_RESULT_AVAILABLE)
+#define GL_QUERY_RESULT_AVAILABLE 0x8867
+#endif
+#if !defined(APIENTRY)
+#define APIENTRY
+#endif
+
 // magic numbers...
 #define KEEP_XANGLE 361
 #define KEEP_YANGLE -91
@@ -114,6 +144,11 @@ int displayHeightGetter = -1;
 string cwd;
 wid_t windowId  = "-1"; 
 const double PI = 3.141592653589793;
+// gluPerspective() in RenderPanoramaGL() and every cpu side inverse of it
+// (software rendering, picking) must agree; 4 / 3 is integer division, so
+// the frustum is square and stretched to the window
+const double FIELD_OF_VIEW = 60;
+const double PROJECTION_ASPECT = 4 / 3;
 
 #if defined(_WIN32)
 wstring widen(string str) {
@@ -129,17 +164,58 @@ string narrow(wstring wstr) {
 }
 #endif
 
-void LoadImage(unsigned char **out, unsigned *pngwidth, unsigned *pngheight, 
+#if !defined(_WIN32)
+double InflateEnd = -1;
+unsigned TracedZlibDecompress(unsigned char **out, size_t *outsize, const unsigned char *in,
+  size_t insize, const LodePNGDecompressSettings *settings) {
+  // lodepng_zlib_decompress() only consults custom_inflate, so this can't recurse
+  double begin = Tracer::Now();
+  unsigned error = lodepng_zlib_decompress(out, outsize, in, insize, settings);
+  InflateEnd = Tracer::Now();
+  Tracer::Complete("inflate", begin, InflateEnd);
+  return error;
+}
+#endif
+
+unsigned DecodeImage(unsigned char **data, unsigned *pngwidth, unsigned *pngheight, 
   const char *fname) {
-  unsigned char *data = nullptr;
   #if defined(_WIN32)
+  Tracer::ZONE zone("libpng_decode32_file");
   wstring u8fname = widen(fname); 
-  unsigned error = libpng_decode32_file(&data, pngwidth, pngheight, u8fname.c_str());
+  return libpng_decode32_file(data, pngwidth, pngheight, u8fname.c_str());
   #else
-  unsigned error = lodepng_decode32_file(&data, pngwidth, pngheight, fname);
+  if (!Tracer::Enabled()) 
+    return lodepng_decode32_file(data, pngwidth, pngheight, fname);
+  // same as lodepng_decode32_file(), split up so each stage gets its own zone
+  unsigned char *png = nullptr; size_t pngsize = 0; unsigned error = 0;
+  double begin = Tracer::Now();
+  error = lodepng_load_file(&png, &pngsize, fname);
+  Tracer::Complete("lodepng_load_file", begin, Tracer::Now());
+  if (error) { free(png); return error; }
+  LodePNGState state; lodepng_state_init(&state);
+  state.info_raw.colortype = LCT_RGBA;
+  state.info_raw.bitdepth = 8;
+  state.decoder.zlibsettings.custom_zlib = TracedZlibDecompress;
+  InflateEnd = -1; begin = Tracer::Now();
+  error = lodepng_decode(data, pngwidth, pngheight, &state, png, pngsize);
+  double end = Tracer::Now();
+  Tracer::Complete("lodepng_decode", begin, end);
+  // everything after inflate is unfiltering, plus color conversion if needed
+  if (InflateEnd >= 0) Tracer::Complete("unfilter", InflateEnd, end);
+  lodepng_state_cleanup(&state);
+  free(png);
+  return error;
   #endif
+}
+
+void LoadImage(unsigned char **out, unsigned *pngwidth, unsigned *pngheight, 
+  const char *fname) {
+  Tracer::ZONE zone("LoadImage");
+  unsigned char *data = nullptr;
+  unsigned error = DecodeImage(&data, pngwidth, pngheight, fname);
   if (error) { return; } unsigned width = *pngwidth, height = *pngheight;
 
+  Tracer::ZONE flip("flip");
   const int size = width * height * 4;
   unsigned char *buffer = new unsigned char[size]();
 
@@ -160,12 +236,57 @@ void LoadImage(unsigned char **out, unsigned *pngwidth, unsigned *pngheight,
 
 GLuint tex;
 double TexWidth, TexHeight, AspectRatio;
+bool SoftwareRendering = false;
+// PANORAMA_CACHE=0 turns the cross process cache off, see LoadPanorama()
+bool SharedPanoramas = true;
+vector<unsigned char> TexPixels;
+TextureCache::IMAGE TexShared = { nullptr, 0, 0, nullptr };
+
+/* the panorama as LoadImage() returns it, whichever copy we hold */
+const unsigned char *PanoramaPixels() {
+  if (TexShared.Pixels) return TexShared.Pixels;
+  return TexPixels.empty() ? nullptr : TexPixels.data();
+}
+
+void ReleasePanoramaPixels() {
+  TextureCache::Release(&TexShared);
+  TexPixels.clear();
+}
+
+unsigned DecodeForCache(const char *fname, unsigned char **out, unsigned *pngwidth, unsigned *pngheight) {
+  LoadImage(out, pngwidth, pngheight, fname);
+  return *out ? 0 : 1;
+}
+
+/* other panoview processes viewing the same file map the pixels in
+shared memory instead of decoding again; the gpu path lets go of its
+reference once the texture is uploaded, which frees the segment unless
+another process still has it mapped, the cpu renderer samples the pixels
+and so keeps it for as long as the panorama is loaded */
 void LoadPanorama(const char *fname) {
-  unsigned char *data = nullptr;
-  unsigned pngwidth, pngheight;
-  LoadImage(&data, &pngwidth, &pngheight, fname);
+  unsigned char *data = nullptr; const unsigned char *pixels = nullptr;
+  unsigned pngwidth = 0, pngheight = 0;
+  ReleasePanoramaPixels();
+  bool shared = false;
+  if (SharedPanoramas) {
+    Tracer::ZONE zone("TextureCache::Acquire");
+    shared = TextureCache::Acquire(fname, DecodeForCache, &TexShared);
+  }
+  if (shared) {
+    pixels = TexShared.Pixels;
+    pngwidth = TexShared.Width; pngheight = TexShared.Height;
+  } else {
+    LoadImage(&data, &pngwidth, &pngheight, fname);
+    pixels = data;
+  }
   TexWidth  = pngwidth; TexHeight = pngheight;
   AspectRatio = TexWidth / TexHeight;
+  if (SoftwareRendering) {
+    // the cpu renderer samples the decoded pixels, so skip the upload
+    if (data) TexPixels.assign(data, data + (size_t)pngwidth * pngheight * 4);
+    delete[] data;
+    return;
+  }
 
   glGenTextures(1, &tex);
   glBindTexture(GL_TEXTURE_2D, tex);
@@ -175,80 +296,545 @@ void LoadPanorama(const char *fname) {
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 
+  Tracer::ZONE zone("glTexImage2D");
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, pngwidth, pngheight, 0, 
-  GL_RGBA, GL_UNSIGNED_BYTE, data);
+  GL_RGBA, GL_UNSIGNED_BYTE, pixels);
   delete[] data;
+  TextureCache::Release(&TexShared);
 }
 
-double xangle, yangle;
-void DrawPanorama() {
-  double i, resolution  = 0.3141592653589793;
-  double height = 700 / AspectRatio, radius = 100;
+typedef struct {
+  vector<float> Vertices;
+  vector<float> TexCoords;
+  int TopFirst, TopCount;
+  int BottomFirst, BottomCount;
+  int WallFirst, WallCount;
+} MESH;
+
+void MeshAddVertex(MESH *mesh, float s, float t, float x, float y, float z) {
+  mesh->TexCoords.push_back(s); mesh->TexCoords.push_back(t);
+  mesh->Vertices.push_back(x); mesh->Vertices.push_back(y); mesh->Vertices.push_back(z);
+}
 
-  glPushMatrix(); glTranslatef(0, -350 / AspectRatio, 0);
-  glRotatef(xangle + 90, 0, 90 + 1, 0);
-  glBegin(GL_TRIANGLE_FAN);
+/* the cylinder only depends on the aspect ratio, so it is built once per
+texture instead of being re-emitted in immediate mode every frame */
+void BuildPanoramaMesh(double aspect, MESH *mesh) {
+  double i, resolution  = 0.3141592653589793;
+  double height = 700 / aspect, radius = 100;
+  mesh->Vertices.clear(); mesh->TexCoords.clear();
 
-  glTexCoord2f(0.5, 1); glVertex3f(0, height, 0);
+  mesh->TopFirst = 0;
+  MeshAddVertex(mesh, 0.5, 1, 0, height, 0);
   for (i = 2 * PI; i >= 0; i -= resolution) {
-    glTexCoord2f(0.5f * cos(i) + 0.5f, 0.5f * sin(i) + 0.5f);
-    glVertex3f(radius * cos(i), height, radius * sin(i));
+    MeshAddVertex(mesh, 0.5f * cos(i) + 0.5f, 0.5f * sin(i) + 0.5f,
+    radius * cos(i), height, radius * sin(i));
   }
 
-  glTexCoord2f(0.5, 0.5); glVertex3f(radius, height, 0);
-  glEnd(); glBegin(GL_TRIANGLE_FAN);
-  glTexCoord2f(0.5, 0.5); glVertex3f(0, 0, 0);
+  MeshAddVertex(mesh, 0.5, 0.5, radius, height, 0);
+  mesh->TopCount = (int)mesh->TexCoords.size() / 2 - mesh->TopFirst;
+  mesh->BottomFirst = (int)mesh->TexCoords.size() / 2;
+  MeshAddVertex(mesh, 0.5, 0.5, 0, 0, 0);
   for (i = 0; i <= 2 * PI; i += resolution) {
-    glTexCoord2f(0.5f * cos(i) + 0.5f, 0.5f * sin(i) + 0.5f);
-    glVertex3f(radius * cos(i), 0, radius * sin(i));
+    MeshAddVertex(mesh, 0.5f * cos(i) + 0.5f, 0.5f * sin(i) + 0.5f,
+    radius * cos(i), 0, radius * sin(i));
   }
 
-  glEnd(); glBegin(GL_QUAD_STRIP);
+  mesh->BottomCount = (int)mesh->TexCoords.size() / 2 - mesh->BottomFirst;
+  mesh->WallFirst = (int)mesh->TexCoords.size() / 2;
   for (i = 0; i <= 2 * PI; i += resolution) {
     const float tc = (i / (float)(2 * PI));
-    glTexCoord2f(tc, 0.0);
-    glVertex3f(radius * cos(i), 0, radius * sin(i));
-    glTexCoord2f(tc, 1.0);
-    glVertex3f(radius * cos(i), height, radius * sin(i));
+    MeshAddVertex(mesh, tc, 0.0, radius * cos(i), 0, radius * sin(i));
+    MeshAddVertex(mesh, tc, 1.0, radius * cos(i), height, radius * sin(i));
   }
 
-  glTexCoord2f(0.0, 0.0);
-  glVertex3f(radius, 0, 0);
-  glTexCoord2f(0.0, 1.0);
-  glVertex3f(radius, height, 0);
-  glEnd(); glPopMatrix();
+  MeshAddVertex(mesh, 0.0, 0.0, radius, 0, 0);
+  MeshAddVertex(mesh, 0.0, 1.0, radius, height, 0);
+  mesh->WallCount = (int)mesh->TexCoords.size() / 2 - mesh->WallFirst;
 }
 
-GLuint cur;
-void LoadCursor(const char *fname) {
-  unsigned char *data = nullptr;
-  unsigned pngwidth, pngheight;
-  LoadImage(&data, &pngwidth, &pngheight, fname);
+double xangle, yangle;
+/* mouse look damping per second, the camera coasts for a moment after the
+mouse stops; PANORAMA_DAMPING overrides it, 0 turns coasting off */
+double CameraDamping = 12;
+Camera::STATE ViewCamera;
+// false for views that shouldn't take the mouse, see ServePanoramas()
+bool MouseLookActive = true;
+
+MESH PanoramaMesh;
+double PanoramaMeshAspect = -1;
+void DrawPanorama() {
+  if (PanoramaMeshAspect != AspectRatio) {
+    BuildPanoramaMesh(AspectRatio, &PanoramaMesh);
+    PanoramaMeshAspect = AspectRatio;
+  }
 
-  glGenTextures(1, &cur);
-  glBindTexture(GL_TEXTURE_2D, cur);
+  glPushMatrix(); glTranslatef(0, -350 / AspectRatio, 0);
+  glRotatef(xangle + 90, 0, 90 + 1, 0);
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+  glVertexPointer(3, GL_FLOAT, 0, PanoramaMesh.Vertices.data());
+  glTexCoordPointer(2, GL_FLOAT, 0, PanoramaMesh.TexCoords.data());
+  glDrawArrays(GL_TRIANGLE_FAN, PanoramaMesh.TopFirst, PanoramaMesh.TopCount);
+  glDrawArrays(GL_TRIANGLE_FAN, PanoramaMesh.BottomFirst, PanoramaMesh.BottomCount);
+  glDrawArrays(GL_QUAD_STRIP, PanoramaMesh.WallFirst, PanoramaMesh.WallCount);
+  glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+  glPopMatrix();
+}
 
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+typedef void (APIENTRY *GLGENQUERIES)(GLsizei n, GLuint *ids);
+typedef void (APIENTRY *GLBEGINQUERY)(GLenum target, GLuint id);
+typedef void (APIENTRY *GLENDQUERY)(GLenum target);
+typedef void (APIENTRY *GLGETQUERYOBJECTIV)(GLuint id, GLenum pname, GLint *params);
+typedef void (APIENTRY *GLGETQUERYOBJECTUI64V)(GLuint id, GLenum pname, unsigned long long *params);
+GLGENQUERIES          glGenQueriesProc          = nullptr;
+GLBEGINQUERY          glBeginQueryProc          = nullptr;
+GLENDQUERY            glEndQueryProc            = nullptr;
+GLGETQUERYOBJECTIV    glGetQueryObjectivProc    = nullptr;
+GLGETQUERYOBJECTUI64V glGetQueryObjectui64vProc = nullptr;
+
+void *GLProcAddress(const char *name) {
+  #if defined(_WIN32)
+  return (void *)wglGetProcAddress(name);
+  #elif (defined(__linux__) && !defined(__ANDROID__)) || defined(__FreeBSD__)
+  return (void *)glXGetProcAddressARB((const GLubyte *)name);
+  #else
+  return nullptr;
+  #endif
+}
 
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, pngwidth, pngheight, 0, 
-  GL_RGBA, GL_UNSIGNED_BYTE, data);
+/* two queries used alternately so reading last frame's result never
+stalls the pipeline waiting on the frame that was just submitted */
+GLuint gpuQuery[2];
+bool gpuQueryPending[2];
+unsigned gpuQueryFrame = 0;
+void GpuTimerInit() {
+  const char *ext = (const char *)glGetString(GL_EXTENSIONS);
+  const char *ver = (const char *)glGetString(GL_VERSION);
+  bool supported = (ver && strtod(ver, nullptr) >= 3.3) || (ext && 
+  (strstr(ext, "GL_ARB_timer_query") || strstr(ext, "GL_EXT_timer_query")));
+  if (!supported) return;
+  glGenQueriesProc          = (GLGENQUERIES)GLProcAddress("glGenQueries");
+  glBeginQueryProc          = (GLBEGINQUERY)GLProcAddress("glBeginQuery");
+  glEndQueryProc            = (GLENDQUERY)GLProcAddress("glEndQuery");
+  glGetQueryObjectivProc    = (GLGETQUERYOBJECTIV)GLProcAddress("glGetQueryObjectiv");
+  glGetQueryObjectui64vProc = (GLGETQUERYOBJECTUI64V)GLProcAddress("glGetQueryObjectui64v");
+  if (!glGetQueryObjectui64vProc)
+    glGetQueryObjectui64vProc = (GLGETQUERYOBJECTUI64V)GLProcAddress("glGetQueryObjectui64vEXT");
+  if (!glGenQueriesProc || !glBeginQueryProc || !glEndQueryProc || 
+    !glGetQueryObjectivProc || !glGetQueryObjectui64vProc) {
+    glBeginQueryProc = nullptr;
+    return;
+  }
+  glGenQueriesProc(2, gpuQuery);
+}
+
+void GpuTimerBegin() {
+  if (!glBeginQueryProc) return;
+  glBeginQueryProc(GL_TIME_ELAPSED, gpuQuery[gpuQueryFrame & 1]);
+}
+
+void GpuTimerEnd() {
+  if (!glBeginQueryProc) return;
+  glEndQueryProc(GL_TIME_ELAPSED);
+  gpuQueryPending[gpuQueryFrame & 1] = true;
+}
+
+double GpuTimerResult() {
+  // result of the previous frame, or -1 when it is not ready yet
+  unsigned i = (gpuQueryFrame + 1) & 1; gpuQueryFrame++;
+  if (!glBeginQueryProc || !gpuQueryPending[i]) return -1;
+  GLint available = 0;
+  glGetQueryObjectivProc(gpuQuery[i], GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available) return -1;
+  unsigned long long elapsed = 0; gpuQueryPending[i] = false;
+  glGetQueryObjectui64vProc(gpuQuery[i], GL_QUERY_RESULT, &elapsed);
+  return elapsed / 1000000.0;
+}
+
+bool ShowHud = false;
+vector<string> HudLines;
+double HudRefreshed = -1;
+void DrawHud() {
+  // percentiles are refreshed four times a second, not every frame
+  double now = FrameTimer::Now();
+  if (HudRefreshed < 0 || now - HudRefreshed >= 250) {
+    HudLines.clear(); HudRefreshed = now;
+    HudLines.push_back("phase       p50     p95     p99 (ms)");
+    for (int i = 0; i < FrameTimer::PHASE_COUNT; i++) {
+      FrameTimer::PHASE phase = (FrameTimer::PHASE)i; char line[64];
+      if (phase == FrameTimer::PHASE_GPU && !glBeginQueryProc) continue;
+      snprintf(line, sizeof(line), "%-8s %7.2f %7.2f %7.2f", FrameTimer::PhaseName(phase),
+      FrameTimer::Percentile(phase, 50), FrameTimer::Percentile(phase, 95), 
+      FrameTimer::Percentile(phase, 99));
+      HudLines.push_back(line);
+    }
+  }
+  int width = 8 * 38 + 12, height = 15 * (int)HudLines.size() + 8;
+  glDisable(GL_TEXTURE_2D);
+  glColor4f(0, 0, 0, 0.6); glBegin(GL_QUADS);
+  glVertex2f(4, 4); glVertex2f(4, 4 + height);
+  glVertex2f(4 + width, 4 + height); glVertex2f(4 + width, 4);
+  glEnd(); glColor4f(1, 1, 1, 1);
+  for (size_t i = 0; i < HudLines.size(); i++) {
+    glRasterPos2i(10, 18 + 15 * (int)i);
+    for (size_t j = 0; j < HudLines[i].length(); j++)
+      glutBitmapCharacter(GLUT_BITMAP_8_BY_13, HudLines[i][j]);
+  }
+}
+
+vector<unsigned char> SoftFrame;
+void DrawPanoramaSoftware(int ww, int wh) {
+  if (ww <= 0 || wh <= 0 || !PanoramaPixels()) return;
+  SoftRender::TEXTURE texture = { PanoramaPixels(), (unsigned)TexWidth, (unsigned)TexHeight };
+  SoftRender::CAMERA camera;
+  SoftRender::CameraFromAngles(xangle, yangle, FIELD_OF_VIEW, PROJECTION_ASPECT, &camera);
+  SoftFrame.resize((size_t)ww * wh * 4);
+  SoftRender::RenderPanorama(&texture, &camera, SoftFrame.data(), ww, wh, 
+  SoftRender::FILTER_NEAREST, 0);
+  glRasterPos2i(0, 0); glPixelZoom(1, -1);
+  glDrawPixels(ww, wh, GL_RGBA, GL_UNSIGNED_BYTE, SoftFrame.data());
+  glPixelZoom(1, 1);
+}
+
+// GL 1.2, which Windows' headers stop short of
+#if !defined(GL_TEXTURE_MAX_LEVEL)
+#define GL_TEXTURE_MAX_LEVEL 0x813D
+#endif
+
+/* cursors and marker icons, keyed by path, size and modification time;
+a file is decoded and packed the first time it's named, afterwards
+switching to it costs nothing, and a rewritten file is loaded anew */
+Atlas::ATLAS Sprites;
+GLuint SpriteTexture = 0;
+int cur = -1;
+
+/* uploads what packing changed: every level when the atlas grew, else
+just the band of rows the new sprites landed in */
+void SpriteUpload() {
+  Tracer::ZONE zone("SpriteUpload");
+  if (!SpriteTexture) {
+    glGenTextures(1, &SpriteTexture);
+    glBindTexture(GL_TEXTURE_2D, SpriteTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, Atlas::LEVELS - 1);
+    Sprites.Resized = true;
+  }
+  glBindTexture(GL_TEXTURE_2D, SpriteTexture);
+  for (unsigned level = 0; level < Atlas::LEVELS; level++) {
+    unsigned width = std::max(Sprites.Width >> level, 1u);
+    unsigned height = std::max(Sprites.Height >> level, 1u);
+    if (Sprites.Resized) {
+      glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, width, height, 0, 
+      GL_RGBA, GL_UNSIGNED_BYTE, Sprites.Levels[level].data());
+    } else if (Sprites.DirtyTop > Sprites.DirtyBottom) {
+      unsigned bottom = Sprites.DirtyBottom >> level;
+      unsigned top = std::min((Sprites.DirtyTop + (1u << level) - 1) >> level, height);
+      glTexSubImage2D(GL_TEXTURE_2D, level, 0, bottom, width, top - bottom,
+      GL_RGBA, GL_UNSIGNED_BYTE, &Sprites.Levels[level][(size_t)bottom * width * 4]);
+    }
+  }
+  Atlas::Clean(&Sprites);
+}
+
+string SpriteKey(const char *fname) {
+  #if defined(_WIN32)
+  struct _stat64 info;
+  if (_wstat64(widen(fname).c_str(), &info)) return fname;
+  #else
+  struct stat info;
+  if (stat(fname, &info)) return fname;
+  #endif
+  return string(fname) + "|" + std::to_string((long long)info.st_size) + "|" +
+  std::to_string((long long)info.st_mtime);
+}
+
+// the sprites a view or the markers still draw, defined with the views
+void SpritesInUse(vector<bool> *inuse);
+
+/* sprite for an image file, or -1 if it can't be loaded or won't fit; a
+full atlas first drops what nothing draws anymore, stale versions of a
+rewritten file say, and is packed anew */
+int LoadSprite(const char *fname) {
+  string key = SpriteKey(fname);
+  int sprite = Atlas::Find(&Sprites, key);
+  if (sprite >= 0) return sprite;
+  if (!Sprites.Width) {
+    GLint maximum = 0; glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maximum);
+    Atlas::Create(&Sprites, 256, 256, std::max(maximum, (GLint)256));
+  }
+  unsigned char *data = nullptr;
+  unsigned pngwidth = 0, pngheight = 0;
+  LoadImage(&data, &pngwidth, &pngheight, fname);
+  if (!data) return -1;
+  sprite = Atlas::Pack(&Sprites, key, data, pngwidth, pngheight);
+  if (sprite < 0) {
+    vector<bool> inuse(Sprites.Sprites.size(), false);
+    SpritesInUse(&inuse);
+    for (size_t i = 0; i < inuse.size(); i++)
+      if (!inuse[i]) Atlas::Release(&Sprites, (int)i);
+    if (Atlas::Repack(&Sprites))
+      sprite = Atlas::Pack(&Sprites, key, data, pngwidth, pngheight);
+  }
   delete[] data;
+  if (sprite >= 0 || Sprites.Resized) SpriteUpload();
+  return sprite;
 }
 
-void DrawCursor(GLuint texid, int curx, int cury, int curwidth, int curheight) {
-  glBindTexture(GL_TEXTURE_2D, texid); glEnable(GL_TEXTURE_2D);
+/* a cursor that fails to load leaves the current one in place */
+void LoadCursor(const char *fname) {
+  int sprite = LoadSprite(fname);
+  if (sprite >= 0) cur = sprite;
+  else std::cerr << "Cursor Failed: " << fname << std::endl;
+}
+
+void DrawCursor(int sprite, int curx, int cury, int curwidth, int curheight) {
+  if (sprite < 0) return;
+  float s0, t0, s1, t1; Atlas::TexCoords(&Sprites, sprite, &s0, &t0, &s1, &t1);
+  glBindTexture(GL_TEXTURE_2D, SpriteTexture); glEnable(GL_TEXTURE_2D);
   glColor4f(1, 1, 1, 1); glBegin(GL_QUADS);
 
-  glTexCoord2f(0, 1); glVertex2f(curx, cury);
-  glTexCoord2f(0, 0); glVertex2f(curx, cury + curheight);
-  glTexCoord2f(1, 0); glVertex2f(curx + curwidth, cury + curheight);
-  glTexCoord2f(1, 1); glVertex2f(curx + curwidth, cury);
+  glTexCoord2f(s0, t1); glVertex2f(curx, cury);
+  glTexCoord2f(s0, t0); glVertex2f(curx, cury + curheight);
+  glTexCoord2f(s1, t0); glVertex2f(curx + curwidth, cury + curheight);
+  glTexCoord2f(s1, t1); glVertex2f(curx + curwidth, cury);
   glEnd(); glDisable(GL_TEXTURE_2D);
 }
 
+// shaders are core in 2.0, instancing in 3.3, older headers lack them
+#if !defined(GL_FRAGMENT_SHADER)
+#define GL_FRAGMENT_SHADER 0x8B30
+#endif
+#if !defined(GL_VERTEX_SHADER)
+#define GL_VERTEX_SHADER 0x8B31
+#endif
+#if !defined(GL_COMPILE_STATUS)
+#define GL_COMPILE_STATUS 0x8B81
+#endif
+#if !defined(GL_LINK_STATUS)
+#define GL_LINK_STATUS 0x8B82
+#endif
+
+typedef GLuint (APIENTRY *GLCREATESHADER)(GLenum type);
+typedef void (APIENTRY *GLSHADERSOURCE)(GLuint shader, GLsizei count, const char *const *string, const GLint *length);
+typedef void (APIENTRY *GLCOMPILESHADER)(GLuint shader);
+typedef void (APIENTRY *GLGETSHADERIV)(GLuint shader, GLenum pname, GLint *params);
+typedef GLuint (APIENTRY *GLCREATEPROGRAM)();
+typedef void (APIENTRY *GLATTACHSHADER)(GLuint program, GLuint shader);
+typedef void (APIENTRY *GLBINDATTRIBLOCATION)(GLuint program, GLuint index, const char *name);
+typedef void (APIENTRY *GLLINKPROGRAM)(GLuint program);
+typedef void (APIENTRY *GLGETPROGRAMIV)(GLuint program, GLenum pname, GLint *params);
+typedef void (APIENTRY *GLUSEPROGRAM)(GLuint program);
+typedef GLint (APIENTRY *GLGETUNIFORMLOCATION)(GLuint program, const char *name);
+typedef void (APIENTRY *GLUNIFORM1I)(GLint location, GLint v0);
+typedef void (APIENTRY *GLUNIFORM1F)(GLint location, GLfloat v0);
+typedef void (APIENTRY *GLUNIFORM2F)(GLint location, GLfloat v0, GLfloat v1);
+typedef void (APIENTRY *GLUNIFORM4F)(GLint location, GLfloat v0, GLfloat v1, GLfloat v2, GLfloat v3);
+typedef void (APIENTRY *GLVERTEXATTRIBPOINTER)(GLuint index, GLint size, GLenum type, 
+  GLboolean normalized, GLsizei stride, const void *pointer);
+typedef void (APIENTRY *GLENABLEVERTEXATTRIBARRAY)(GLuint index);
+typedef void (APIENTRY *GLVERTEXATTRIBDIVISOR)(GLuint index, GLuint divisor);
+typedef void (APIENTRY *GLDRAWARRAYSINSTANCED)(GLenum mode, GLint first, GLsizei count, GLsizei primcount);
+GLCREATESHADER            glCreateShaderProc            = nullptr;
+GLSHADERSOURCE            glShaderSourceProc            = nullptr;
+GLCOMPILESHADER           glCompileShaderProc           = nullptr;
+GLGETSHADERIV             glGetShaderivProc             = nullptr;
+GLCREATEPROGRAM           glCreateProgramProc           = nullptr;
+GLATTACHSHADER            glAttachShaderProc            = nullptr;
+GLBINDATTRIBLOCATION      glBindAttribLocationProc      = nullptr;
+GLLINKPROGRAM             glLinkProgramProc             = nullptr;
+GLGETPROGRAMIV            glGetProgramivProc            = nullptr;
+GLUSEPROGRAM              glUseProgramProc              = nullptr;
+GLGETUNIFORMLOCATION      glGetUniformLocationProc      = nullptr;
+GLUNIFORM1I               glUniform1iProc               = nullptr;
+GLUNIFORM1F               glUniform1fProc               = nullptr;
+GLUNIFORM2F               glUniform2fProc               = nullptr;
+GLUNIFORM4F               glUniform4fProc               = nullptr;
+GLVERTEXATTRIBPOINTER     glVertexAttribPointerProc     = nullptr;
+GLENABLEVERTEXATTRIBARRAY glEnableVertexAttribArrayProc  = nullptr;
+GLENABLEVERTEXATTRIBARRAY glDisableVertexAttribArrayProc = nullptr;
+GLVERTEXATTRIBDIVISOR     glVertexAttribDivisorProc     = nullptr;
+GLDRAWARRAYSINSTANCED     glDrawArraysInstancedProc     = nullptr;
+
+/* markers from PANORAMA_MARKERS, icons from PANORAMA_MARKER_ATLAS: a row
+of square icons, as many as the image is wide over high, packed into the
+sprite atlas like the cursor; without one every marker wears the cursor.
+They are culled on the CPU each frame and the survivors drawn in one go,
+instanced where the driver can, one array of quads where it can't */
+Overlay::MARKERS Markers;
+vector<float> MarkersVisible, MarkerQuads;
+int MarkerSprite = -1;
+GLuint MarkerProgram = 0;
+GLint MarkerSize, MarkerIcons, MarkerRect, MarkerTexture;
+float MarkerIconCount = 1;
+const int MARKER_SIZE = 32;
+enum { MARKER_CORNER = 1, MARKER_INSTANCE = 2 };
+
+const char *MarkerVertexShader =
+"#version 120\n"
+"attribute vec2 Corner;\n"
+"attribute vec3 Instance;\n"
+"uniform vec2 Size;\n"
+"uniform float Icons;\n"
+"uniform vec4 Rect;\n"
+"varying vec2 TexCoord;\n"
+"void main() {\n"
+"  gl_Position = vec4(Instance.xy + Corner * Size, 0.0, 1.0);\n"
+"  vec2 icon = vec2((Instance.z + Corner.x * 0.5 + 0.5) / Icons, Corner.y * 0.5 + 0.5);\n"
+"  TexCoord = mix(Rect.xy, Rect.zw, icon);\n"
+"}\n";
+
+const char *MarkerFragmentShader =
+"#version 120\n"
+"uniform sampler2D Atlas;\n"
+"varying vec2 TexCoord;\n"
+"void main() {\n"
+"  gl_FragColor = texture2D(Atlas, TexCoord);\n"
+"}\n";
+
+GLuint MarkerShader(GLenum type, const char *source) {
+  GLuint shader = glCreateShaderProc(type); GLint status = 0;
+  glShaderSourceProc(shader, 1, &source, nullptr);
+  glCompileShaderProc(shader);
+  glGetShaderivProc(shader, GL_COMPILE_STATUS, &status);
+  return status ? shader : 0;
+}
+
+void MarkerProgramInit() {
+  const char *ext = (const char *)glGetString(GL_EXTENSIONS);
+  const char *ver = (const char *)glGetString(GL_VERSION);
+  double version = ver ? strtod(ver, nullptr) : 0;
+  bool supported = version >= 2.0 && (version >= 3.3 || (ext && 
+  strstr(ext, "GL_ARB_instanced_arrays") && strstr(ext, "GL_ARB_draw_instanced")));
+  if (!supported) return;
+  glCreateShaderProc             = (GLCREATESHADER)GLProcAddress("glCreateShader");
+  glShaderSourceProc             = (GLSHADERSOURCE)GLProcAddress("glShaderSource");
+  glCompileShaderProc            = (GLCOMPILESHADER)GLProcAddress("glCompileShader");
+  glGetShaderivProc              = (GLGETSHADERIV)GLProcAddress("glGetShaderiv");
+  glCreateProgramProc            = (GLCREATEPROGRAM)GLProcAddress("glCreateProgram");
+  glAttachShaderProc             = (GLATTACHSHADER)GLProcAddress("glAttachShader");
+  glBindAttribLocationProc       = (GLBINDATTRIBLOCATION)GLProcAddress("glBindAttribLocation");
+  glLinkProgramProc              = (GLLINKPROGRAM)GLProcAddress("glLinkProgram");
+  glGetProgramivProc             = (GLGETPROGRAMIV)GLProcAddress("glGetProgramiv");
+  glUseProgramProc               = (GLUSEPROGRAM)GLProcAddress("glUseProgram");
+  glGetUniformLocationProc       = (GLGETUNIFORMLOCATION)GLProcAddress("glGetUniformLocation");
+  glUniform1iProc                = (GLUNIFORM1I)GLProcAddress("glUniform1i");
+  glUniform1fProc                = (GLUNIFORM1F)GLProcAddress("glUniform1f");
+  glUniform2fProc                = (GLUNIFORM2F)GLProcAddress("glUniform2f");
+  glUniform4fProc                = (GLUNIFORM4F)GLProcAddress("glUniform4f");
+  glVertexAttribPointerProc      = (GLVERTEXATTRIBPOINTER)GLProcAddress("glVertexAttribPointer");
+  glEnableVertexAttribArrayProc  = (GLENABLEVERTEXATTRIBARRAY)GLProcAddress("glEnableVertexAttribArray");
+  glDisableVertexAttribArrayProc = (GLENABLEVERTEXATTRIBARRAY)GLProcAddress("glDisableVertexAttribArray");
+  glVertexAttribDivisorProc      = (GLVERTEXATTRIBDIVISOR)GLProcAddress("glVertexAttribDivisor");
+  if (!glVertexAttribDivisorProc)
+    glVertexAttribDivisorProc = (GLVERTEXATTRIBDIVISOR)GLProcAddress("glVertexAttribDivisorARB");
+  glDrawArraysInstancedProc      = (GLDRAWARRAYSINSTANCED)GLProcAddress("glDrawArraysInstanced");
+  if (!glDrawArraysInstancedProc)
+    glDrawArraysInstancedProc = (GLDRAWARRAYSINSTANCED)GLProcAddress("glDrawArraysInstancedARB");
+  if (!glCreateShaderProc || !glShaderSourceProc || !glCompileShaderProc || !glGetShaderivProc ||
+    !glCreateProgramProc || !glAttachShaderProc || !glBindAttribLocationProc || !glLinkProgramProc ||
+    !glGetProgramivProc || !glUseProgramProc || !glGetUniformLocationProc || !glUniform1iProc ||
+    !glUniform1fProc || !glUniform2fProc || !glUniform4fProc || !glVertexAttribPointerProc || 
+    !glEnableVertexAttribArrayProc || !glDisableVertexAttribArrayProc ||
+    !glVertexAttribDivisorProc || !glDrawArraysInstancedProc) {
+    return;
+  }
+  GLuint vertex = MarkerShader(GL_VERTEX_SHADER, MarkerVertexShader);
+  GLuint fragment = MarkerShader(GL_FRAGMENT_SHADER, MarkerFragmentShader);
+  if (!vertex || !fragment) return;
+  GLuint program = glCreateProgramProc(); GLint status = 0;
+  glAttachShaderProc(program, vertex);
+  glAttachShaderProc(program, fragment);
+  glBindAttribLocationProc(program, MARKER_CORNER, "Corner");
+  glBindAttribLocationProc(program, MARKER_INSTANCE, "Instance");
+  glLinkProgramProc(program);
+  glGetProgramivProc(program, GL_LINK_STATUS, &status);
+  if (!status) return;
+  MarkerSize = glGetUniformLocationProc(program, "Size");
+  MarkerIcons = glGetUniformLocationProc(program, "Icons");
+  MarkerRect = glGetUniformLocationProc(program, "Rect");
+  MarkerTexture = glGetUniformLocationProc(program, "Atlas");
+  MarkerProgram = program;
+}
+
+void LoadMarkers(const char *fname, const char *atlas) {
+  if (!fname || !*fname) return;
+  if (!Overlay::LoadMarkers(fname, &Markers)) {
+    std::cerr << "Markers Failed: " << fname << std::endl;
+    return;
+  }
+  MarkerSprite = cur; MarkerIconCount = 1;
+  if (atlas && *atlas) {
+    int sprite = LoadSprite(atlas);
+    if (sprite >= 0) {
+      const Atlas::SPRITE &icons = Sprites.Sprites[sprite];
+      MarkerSprite = sprite; MarkerIconCount = std::fmax(std::floor((double)icons.Width / icons.Height), 1);
+    } else std::cerr << "Marker Atlas Failed: " << atlas << std::endl;
+  }
+  MarkerProgramInit();
+}
+
+/* expects the pixel space ortho projection DisplayGraphics() sets up */
+void DrawMarkers(int ww, int wh) {
+  if (Markers.Name.empty() || MarkerSprite < 0 || ww <= 0 || wh <= 0) return;
+  Tracer::ZONE zone("DrawMarkers");
+  SoftRender::TEXTURE texture = { nullptr, (unsigned)TexWidth, (unsigned)TexHeight };
+  SoftRender::CAMERA camera;
+  SoftRender::CameraFromAngles(xangle, yangle, FIELD_OF_VIEW, PROJECTION_ASPECT, &camera);
+  Overlay::Place(&Markers, &texture);
+  // half an icon, in normalized device coordinates
+  float sizex = (float)MARKER_SIZE / ww, sizey = (float)MARKER_SIZE / wh;
+  MarkersVisible.clear();
+  int count = Overlay::Cull(&Markers, &camera, sizex, sizey, &MarkersVisible);
+  if (!count) return;
+  float s0, t0, s1, t1; Atlas::TexCoords(&Sprites, MarkerSprite, &s0, &t0, &s1, &t1);
+  glBindTexture(GL_TEXTURE_2D, SpriteTexture); glEnable(GL_TEXTURE_2D);
+  glColor4f(1, 1, 1, 1);
+  if (MarkerProgram) {
+    static const float corners[8] = { -1, 1, -1, -1, 1, 1, 1, -1 };
+    glUseProgramProc(MarkerProgram);
+    glUniform2fProc(MarkerSize, sizex, sizey);
+    glUniform1fProc(MarkerIcons, MarkerIconCount);
+    glUniform4fProc(MarkerRect, s0, t0, s1, t1);
+    glUniform1iProc(MarkerTexture, 0);
+    glEnableVertexAttribArrayProc(MARKER_CORNER);
+    glEnableVertexAttribArrayProc(MARKER_INSTANCE);
+    glVertexAttribPointerProc(MARKER_CORNER, 2, GL_FLOAT, GL_FALSE, 0, corners);
+    glVertexAttribPointerProc(MARKER_INSTANCE, 3, GL_FLOAT, GL_FALSE, 0, MarkersVisible.data());
+    glVertexAttribDivisorProc(MARKER_INSTANCE, 1);
+    glDrawArraysInstancedProc(GL_TRIANGLE_STRIP, 0, 4, count);
+    glVertexAttribDivisorProc(MARKER_INSTANCE, 0);
+    glDisableVertexAttribArrayProc(MARKER_INSTANCE);
+    glDisableVertexAttribArrayProc(MARKER_CORNER);
+    glUseProgramProc(0);
+  } else {
+    // same quads expanded here, x y s t per corner, still a single draw
+    MarkerQuads.resize((size_t)count * 16);
+    float half = MARKER_SIZE / 2.0f, *quad = MarkerQuads.data(), step = (s1 - s0) / MarkerIconCount;
+    for (int i = 0; i < count; i++, quad += 16) {
+      float x = (MarkersVisible[i * 3] + 1) / 2 * ww;
+      float y = (1 - MarkersVisible[i * 3 + 1]) / 2 * wh;
+      float left = s0 + MarkersVisible[i * 3 + 2] * step, right = left + step;
+      float corners[16] = { 
+        x - half, y - half, left, t1, x - half, y + half, left, t0,
+        x + half, y + half, right, t0, x + half, y - half, right, t1 
+      };
+      memcpy(quad, corners, sizeof(corners));
+    }
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 4 * sizeof(float), MarkerQuads.data());
+    glTexCoordPointer(2, GL_FLOAT, 4 * sizeof(float), MarkerQuads.data() + 2);
+    glDrawArrays(GL_QUADS, 0, count * 4);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+  }
+  glDisable(GL_TEXTURE_2D);
+}
+
 vector<string> StringSplitByFirstEqualsSign(string str) {
   size_t pos = 0;
   vector<string> vec;
@@ -283,6 +869,7 @@ void window_get_size_from_id(CrossProcess::WINDOWID winId, int *width, int *heig
   *width = rc.right; *height = rc.bottom;
 }
 CrossProcess::PROCID parentProcId = 0;
+CrossProcess::PROCWATCHER parentWatcher = -1;
 void window_id_set_parent_window_id(CrossProcess::WINDOWID wid, CrossProcess::WINDOWID pwid) {
   HWND child = (HWND)(void *)strtoull(wid, nullptr, 10);
   HWND parent = (HWND)(void *)strtoull(pwid, nullptr, 10);
@@ -291,8 +878,6 @@ void window_id_set_parent_window_id(CrossProcess::WINDOWID wid, CrossProcess::WI
   SetWindowLongPtr(child, GWL_STYLE, GetWindowLongPtr(child, GWL_STYLE) & ~(WS_CAPTION | WS_SIZEBOX));
   SetWindowLongPtr(parent, GWL_STYLE, GetWindowLongPtr(parent, GWL_STYLE) | WS_CLIPCHILDREN | WS_CLIPSIBLINGS);
   MoveWindow(child, 0, 0, width, height, true);
-  if (!parentProcId) CrossProcess::ProcIdFromWindowId(pwid, &parentProcId);
-  if (parentProcId && !CrossProcess::ProcIdExists(parentProcId)) exit(0);
 }
 #elif defined(X_PROTOCOL)
 typedef struct {
@@ -333,6 +918,21 @@ int window_get_height_from_id(CrossProcess::WINDOWID winId) {
 }
 #endif
 
+/* parses NAME=VALUE lines, as sent to us over stdin, the last match wins */
+void EnvironFromString(string input, string name, string *value) {
+  vector<string> newlinesplit;
+  newlinesplit = StringSplit(input, "\n");
+  for (int i = 0; i < newlinesplit.size(); i++) {
+    vector<string> equalssplit;
+    equalssplit = StringSplitByFirstEqualsSign(newlinesplit[i]);
+    if (equalssplit.size() == 2) {
+      if (equalssplit[0] == name) {
+        *value = equalssplit[1];
+      }
+    }
+  }
+}
+
 void EnvironFromStdInput(string name, string *value) {
   #if defined(_WIN32)
   DWORD bytesAvail = 0;
@@ -343,17 +943,7 @@ void EnvironFromStdInput(string name, string *value) {
     string buffer; buffer.resize(bytesAvail, '\0');
     if (PeekNamedPipe(hPipe, &buffer[0], bytesAvail, &bytesRead, 
       nullptr, nullptr)) {
-      vector<string> newlinesplit;
-      newlinesplit = StringSplit(buffer, "\n");
-      for (int i = 0; i < newlinesplit.size(); i++) {
-        vector<string> equalssplit;
-        equalssplit = StringSplitByFirstEqualsSign(newlinesplit[i]);
-        if (equalssplit.size() == 2) {
-          if (equalssplit[0] == name) {
-            *value = equalssplit[1];
-          }
-        }
-      }
+      EnvironFromString(buffer, name, value);
     }
   }
   #else
@@ -364,17 +954,7 @@ void EnvironFromStdInput(string name, string *value) {
     buffer[nRead] = '\0';
     input.append(buffer, nRead);
   }
-  vector<string> newlinesplit;
-  newlinesplit = StringSplit(input, "\n");
-  for (int i = 0; i < newlinesplit.size(); i++) {
-    vector<string> equalssplit;
-    equalssplit = StringSplitByFirstEqualsSign(newlinesplit[i]);
-    if (equalssplit.size() == 2) {
-      if (equalssplit[0] == name) {
-        *value = equalssplit[1];
-      }
-    }
-  }
+  EnvironFromString(input, name, value);
   #endif
 }
 
@@ -422,6 +1002,10 @@ void UpdateEnvironmentVariables() {
       yangle = ytemp;
     }
   }
+
+  // the camera drives xangle and yangle every frame, so jump it there too
+  if (!direction.empty() || !zdirection.empty())
+    Camera::Reset(&ViewCamera, xangle, yangle, CameraDamping, FrameTimer::Now());
 }
 
 #if defined(X_PROTOCOL)
@@ -489,12 +1073,11 @@ int DisplayGetHeight() {
 }
 #endif
 
-void DisplayGraphics() {
-  glClearColor(0, 0, 0, 1);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+/* the 3d part of a frame, the view TexelFromViewport() inverts */
+void RenderPanoramaGL() {
   glMatrixMode(GL_PROJECTION);
   glLoadIdentity();
-  gluPerspective(60, 4 / 3, 0.1, 1024);
+  gluPerspective(FIELD_OF_VIEW, PROJECTION_ASPECT, 0.1, 1024);
   glMatrixMode(GL_MODELVIEW);
   glLoadIdentity();
   glEnable(GL_CULL_FACE);
@@ -506,23 +1089,49 @@ void DisplayGraphics() {
   glEnable(GL_TEXTURE_2D);
   glBindTexture(GL_TEXTURE_2D, tex);
   DrawPanorama(); glFlush();
-  glClear(GL_DEPTH_BITS);
-  glMatrixMode(GL_PROJECTION);
-  glLoadIdentity();
+}
+
+void UpdateMouseLook();
+void DisplayGraphics() {
+  Tracer::ZONE zone("DisplayGraphics");
+  UpdateMouseLook();
+  FrameTimer::PhaseBegin(FrameTimer::PHASE_DRAW);
+  GpuTimerBegin();
+  glClearColor(0, 0, 0, 1);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   int ww = window_get_width_from_id((CrossProcess::WINDOWID)windowId.c_str());
   int wh = window_get_height_from_id((CrossProcess::WINDOWID)windowId.c_str());
+  if (!SoftwareRendering) {
+    RenderPanoramaGL();
+    glClear(GL_DEPTH_BITS);
+  }
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
   glOrtho(0, ww, wh, 0, -1, 1);
   glMatrixMode(GL_MODELVIEW);
   glLoadIdentity();
   glDisable(GL_CULL_FACE);
   glDisable(GL_DEPTH_TEST);
+  if (SoftwareRendering) {
+    glDisable(GL_TEXTURE_2D);
+    DrawPanoramaSoftware(ww, wh);
+  }
   glEnable(GL_BLEND);
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
   glEnable(GL_TEXTURE_2D);
-  glBindTexture(GL_TEXTURE_2D, cur);
+  DrawMarkers(ww, wh);
   DrawCursor(cur, (ww / 2) - 16, (wh / 2) - 16, 32, 32);
+  if (ShowHud) DrawHud();
   glBlendFunc(GL_ONE, GL_ZERO);
-  glutSwapBuffers();
+  GpuTimerEnd();
+  FrameTimer::PhaseEnd(FrameTimer::PHASE_DRAW);
+  FrameTimer::PhaseBegin(FrameTimer::PHASE_SWAP);
+  {
+    Tracer::ZONE swap("glutSwapBuffers");
+    glutSwapBuffers();
+  }
+  FrameTimer::PhaseEnd(FrameTimer::PHASE_SWAP);
+  FrameTimer::FrameEnd(GpuTimerResult());
 }
 
 double PanoramaSetVertAngle() {
@@ -530,9 +1139,7 @@ double PanoramaSetVertAngle() {
 }
 
 void PanoramaSetHorzAngle(double hangle) {
-  xangle -= hangle;
-  if      (xangle > 360) xangle = 0;
-  else if (xangle < 0) xangle = 360;
+  xangle = std::fmod(std::fmod(xangle - hangle, 360) + 360, 360);
 }
 
 double PanoramaGetVertAngle() {
@@ -589,22 +1196,299 @@ void MouseGetPosition(int *mx, int *my) {
   #endif
 }
 
-void UpdateMouseLook() {
+#if defined(X_PROTOCOL)
+int xinputOpcode = -1;
+
+/* what the raw x and y valuators of a slave device mean: relative ones
+are deltas in device units, which we take as pixels, unaccelerated on
+purpose as mouse look shouldn't speed up with a flick; absolute ones,
+tablets, touchscreens and the tablets virtual machines and vnc offer,
+are positions, turned into deltas from the previous one and scaled from
+the axis range to the screen the device maps onto */
+typedef struct {
+  bool Absolute[2];
+  double Scale[2];
+  double Last[2];
+  bool Seen[2];
+} RAWDEVICE;
+std::map<int, RAWDEVICE> RawDevices;
+
+RAWDEVICE RawDeviceFromInfo(const XIDeviceInfo *info) {
+  RAWDEVICE device = { { false, false }, { 1, 1 }, { 0, 0 }, { false, false } };
+  for (int i = 0; i < info->num_classes; i++) {
+    if (info->classes[i]->type != XIValuatorClass) continue;
+    XIValuatorClassInfo *valuator = (XIValuatorClassInfo *)info->classes[i];
+    if (valuator->number < 0 || valuator->number > 1) continue;
+    int axis = valuator->number, screen = XDefaultScreen(display);
+    double extent = axis ? XDisplayHeight(display, screen) : XDisplayWidth(display, screen);
+    device.Absolute[axis] = (valuator->mode == XIModeAbsolute);
+    if (valuator->max > valuator->min) device.Scale[axis] = extent / (valuator->max - valuator->min);
+  }
+  return device;
+}
+
+/* looked up the first time a device moves, and again after it changes */
+RAWDEVICE *RawDeviceFind(int deviceid) {
+  std::map<int, RAWDEVICE>::iterator it = RawDevices.find(deviceid);
+  if (it != RawDevices.end()) return &it->second;
+  int count = 0; XIDeviceInfo *info = XIQueryDevice(display, deviceid, &count);
+  RAWDEVICE device = { { false, false }, { 1, 1 }, { 0, 0 }, { false, false } };
+  if (info && count > 0) device = RawDeviceFromInfo(info);
+  if (info) XIFreeDeviceInfo(info);
+  return &(RawDevices[deviceid] = device);
+}
+
+/* raw motion is unaccelerated device motion delivered to the root window
+whatever the pointer is over, and pointer warps don't generate any, so
+the pointer can still be re-centered without reading it back */
+bool RawMotionInit() {
+  int event, error;
+  if (!XQueryExtension(display, "XInputExtension", &xinputOpcode, &event, &error)) 
+    return false;
+  int major = 2, minor = 0;
+  if (XIQueryVersion(display, &major, &minor) != Success) 
+    return false;
+  unsigned char mask[XIMaskLen(XI_RawMotion)] = { 0 };
+  XIEventMask eventmask;
+  eventmask.deviceid = XIAllMasterDevices;
+  eventmask.mask_len = sizeof(mask);
+  eventmask.mask = mask;
+  XISetMask(mask, XI_RawMotion);
+  // a device whose axes change, or a new one, is looked up again
+  unsigned char changedmask[XIMaskLen(XI_DeviceChanged)] = { 0 };
+  XIEventMask changed;
+  changed.deviceid = XIAllDevices;
+  changed.mask_len = sizeof(changedmask);
+  changed.mask = changedmask;
+  XISetMask(changedmask, XI_DeviceChanged);
+  XIEventMask masks[2] = { eventmask, changed };
+  XISelectEvents(display, XDefaultRootWindow(display), masks, 2);
+  RawDevices.clear();
+  int count = 0; XIDeviceInfo *info = XIQueryDevice(display, XIAllDevices, &count);
+  for (int i = 0; info && i < count; i++)
+    if (info[i].use == XISlavePointer) RawDevices[info[i].deviceid] = RawDeviceFromInfo(&info[i]);
+  if (info) XIFreeDeviceInfo(info);
+  XFlush(display);
+  return true;
+}
+
+/* sums the raw x and y motion of every queued event, fractional parts
+included; XPending() only reads what the server already sent */
+bool RawMotionDrain(double *dx, double *dy) {
+  bool moved = false; *dx = 0; *dy = 0;
+  while (XPending(display)) {
+    XEvent event; XNextEvent(display, &event);
+    XGenericEventCookie *cookie = &event.xcookie;
+    if (cookie->type != GenericEvent || cookie->extension != xinputOpcode || 
+      !XGetEventData(display, cookie)) continue;
+    if (cookie->evtype == XI_RawMotion) {
+      XIRawEvent *raw = (XIRawEvent *)cookie->data;
+      RAWDEVICE *device = RawDeviceFind(raw->sourceid);
+      const double *value = raw->raw_values;
+      for (int i = 0; i < raw->valuators.mask_len * 8 && i < 2; i++) {
+        if (!XIMaskIsSet(raw->valuators.mask, i)) continue;
+        double delta = *value++;
+        if (device->Absolute[i]) {
+          // the first position after a change only sets where deltas start
+          double position = delta;
+          delta = device->Seen[i] ? (position - device->Last[i]) * device->Scale[i] : 0;
+          device->Last[i] = position; device->Seen[i] = true;
+        }
+        if (i == 0) *dx += delta; else *dy += delta;
+        if (delta != 0) moved = true;
+      }
+    } else if (cookie->evtype == XI_DeviceChanged) {
+      XIDeviceChangedEvent *changed = (XIDeviceChangedEvent *)cookie->data;
+      RawDevices.erase(changed->sourceid); RawDevices.erase(changed->deviceid);
+    }
+    XFreeEventData(display, cookie);
+  }
+  return moved;
+}
+#endif
+
+bool RawMotion = false;
+/* pointer motion in screen pixels since the previous call, re-centering
+the pointer when it moved; only ever called from InputThread() */
+bool SampleMouseMotion(double *dx, double *dy) {
   int hdw, hdh, mx, my;
-  ScreenGetCenter(&hdw, &hdh); 
-  MouseGetPosition(&mx, &my); 
+  ScreenGetCenter(&hdw, &hdh);
+  #if defined(X_PROTOCOL)
+  if (RawMotion) {
+    if (!RawMotionDrain(dx, dy)) return false;
+    XWarpPointer(display, None, XDefaultRootWindow(display), 0, 0, 0, 0, hdw, hdh);
+    XFlush(display);
+    return true;
+  }
+  #endif
+  MouseGetPosition(&mx, &my);
+  if (mx == hdw && my == hdh) return false;
+  WarpMouse(hdw, hdh);
+  *dx = mx - hdw; *dy = my - hdh;
+  return true;
+}
+
+std::atomic<bool> InputRunning(false);
+std::thread *InputSampler = nullptr;
+void InputThread() {
+  InputQueue::EVENT pending = { 0, 0, 0 }; bool held = false;
+  while (InputRunning) {
+    #if defined(X_PROTOCOL)
+    if (RawMotion) {
+      // wake when the server sends motion instead of on a fixed period; events
+      // another thread's reply read already pulled in won't show up in poll()
+      if (!XEventsQueued(display, QueuedAlready)) {
+        struct pollfd fd = { ConnectionNumber(display), POLLIN, 0 };
+        poll(&fd, 1, 5);
+      }
+    } else
+    #endif
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    double dx, dy;
+    if (SampleMouseMotion(&dx, &dy)) {
+      pending.Time = FrameTimer::Now();
+      pending.DeltaX += dx; pending.DeltaY += dy; held = true;
+    }
+    // a full queue means the render thread is stalled, keep summing meanwhile
+    if (held && InputQueue::Push(&pending)) {
+      pending.DeltaX = 0; pending.DeltaY = 0; held = false;
+    }
+  }
+}
+
+void InputThreadStart() {
+  if (InputSampler) return;
+  InputRunning = true;
+  InputSampler = new std::thread(InputThread);
+}
+
+void InputThreadStop() {
+  if (!InputSampler) return;
+  InputRunning = false;
+  InputSampler->join();
+  delete InputSampler;
+  InputSampler = nullptr;
+}
+
+/* render thread side, called right before drawing so the frame uses every
+motion sample taken up to that point rather than the last timer tick's */
+void UpdateMouseLook() {
+  Tracer::ZONE zone("UpdateMouseLook");
+  InputQueue::EVENT event;
+  FrameTimer::PhaseBegin(FrameTimer::PHASE_INPUT);
+  while (MouseLookActive && InputQueue::Pop(&event)) {
+    // pixels to degrees, moving right or down turns right or down
+    Camera::AddMotion(&ViewCamera, event.Time, event.DeltaX / 20, event.DeltaY / 20);
+  }
+  FrameTimer::PhaseEnd(FrameTimer::PHASE_INPUT);
+  FrameTimer::PhaseBegin(FrameTimer::PHASE_UPDATE);
+  ViewCamera.MaximumVerticalAngle = MaximumVerticalAngle;
+  Camera::Advance(&ViewCamera, FrameTimer::Now());
+  Camera::Interpolated(&ViewCamera, &xangle, &yangle);
+  FrameTimer::PhaseEnd(FrameTimer::PHASE_UPDATE);
+}
+
+void UpdateViewLimits() {
+  AspectRatio = std::fmin(std::fmax(AspectRatio, 0.1), 6);
+  MaximumVerticalAngle = (std::atan2((700 / AspectRatio) / 2, 100) * 180.0 / PI) - 30;
+}
+
+/* puts the view exactly at the startup angles, wrapped and clamped the same
+way mouse look would; needs the panorama loaded for the vertical limit */
+void InitialViewFromSettings(double initxangle, double inityangle) {
+  UpdateViewLimits();
+  xangle = initxangle; yangle = inityangle;
+  PanoramaSetHorzAngle(0);
+  PanoramaSetVertAngle(0);
+  ViewCamera.MaximumVerticalAngle = MaximumVerticalAngle;
+  Camera::Reset(&ViewCamera, xangle, yangle, CameraDamping, FrameTimer::Now());
+}
+
+/* centers the pointer once before the window is shown, so the first
+UpdateMouseLook() measures no motion and the initial view isn't nudged;
+nothing confines it, mouse look re-centers it on the screen (not the
+window) every sample, and an X grab would be taken on our own display
+connection, not GLUT's, and so keep GLUT from seeing the clicks */
+void PointerCenterInit() {
+  int hdw, hdh;
+  ScreenGetCenter(&hdw, &hdh);
   WarpMouse(hdw, hdh);
-  PanoramaSetHorzAngle((hdw - mx) / 20);
-  PanoramaSetVertAngle((hdh - my) / 20);
+  #if defined(X_PROTOCOL)
+  // XFlush() in WarpMouse() doesn't wait; round trip so the warp is applied
+  XSync(display, False);
+  #endif
+}
+
+/* hotspots from PANORAMA_HOTSPOTS, in texels of the loaded panorama; the
+index is rebuilt lazily whenever either of them changes */
+vector<Picking::HOTSPOT> Hotspots;
+Picking::INDEX HotspotIndex;
+double HotspotIndexWidth = -1, HotspotIndexHeight = -1;
+string HotspotHovered;
+
+void LoadHotspots(const char *fname) {
+  Hotspots.clear(); HotspotIndexWidth = -1;
+  if (fname && *fname && !Picking::LoadHotspots(fname, &Hotspots))
+    std::cerr << "Hotspots Failed: " << fname << std::endl;
+}
+
+/* texel under pixel (x, y) of a ww by wh viewport, top left origin like
+glut's mouse callbacks, through the view RenderPanoramaGL() draws */
+bool TexelFromViewport(double x, double y, int ww, int wh, double *texx, double *texy) {
+  SoftRender::TEXTURE texture = { nullptr, (unsigned)TexWidth, (unsigned)TexHeight };
+  SoftRender::CAMERA camera;
+  SoftRender::CameraFromAngles(xangle, yangle, FIELD_OF_VIEW, PROJECTION_ASPECT, &camera);
+  return Picking::TexelFromScreen(&texture, &camera, x, y, ww, wh, texx, texy);
+}
+
+/* texel under the crosshair, which DrawCursor() centers on the window's
+center, i.e. the corner between its four middle pixels; glut caches the
+window's size, so this costs no round trip to the server */
+bool TexelFromCrosshair(double *texx, double *texy) {
+  int ww = glutGet(GLUT_WINDOW_WIDTH), wh = glutGet(GLUT_WINDOW_HEIGHT);
+  return TexelFromViewport(ww / 2.0 - 0.5, wh / 2.0 - 0.5, ww, wh, texx, texy);
+}
+
+/* the view the hovered hotspot was last picked for; timer() asks every
+tick, but the answer only changes when the view or the index does */
+typedef struct {
+  double XAngle, YAngle;
+  int Width, Height;
+  string Name;
+} HOTSPOTPICK;
+HOTSPOTPICK HotspotPicked = { 0, 0, -1, -1, "" };
+
+/* name of the hotspot under the crosshair at the window's center, if any */
+string HotspotUnderCursor() {
+  if (Hotspots.empty()) return "";
+  if (HotspotIndexWidth != TexWidth || HotspotIndexHeight != TexHeight) {
+    Picking::IndexBuild(&HotspotIndex, Hotspots, TexWidth, TexHeight);
+    HotspotIndexWidth = TexWidth; HotspotIndexHeight = TexHeight;
+    HotspotPicked.Width = -1;
+  }
+  int ww = glutGet(GLUT_WINDOW_WIDTH), wh = glutGet(GLUT_WINDOW_HEIGHT);
+  if (HotspotPicked.XAngle == xangle && HotspotPicked.YAngle == yangle &&
+    HotspotPicked.Width == ww && HotspotPicked.Height == wh) return HotspotPicked.Name;
+  HotspotPicked.XAngle = xangle; HotspotPicked.YAngle = yangle;
+  HotspotPicked.Width = ww; HotspotPicked.Height = wh;
+  HotspotPicked.Name.clear();
+  double texx, texy;
+  if (TexelFromCrosshair(&texx, &texy)) {
+    int hit = Picking::IndexQuery(&HotspotIndex, texx, texy);
+    if (hit >= 0) HotspotPicked.Name = HotspotIndex.Hotspots[hit].Name;
+  }
+  return HotspotPicked.Name;
 }
 
 void GetTexelUnderCursor(int *TexX, int *TexY) {
-  *TexX = abs(round(2 - std::fmod((xangle / 360 + 1) * TexWidth, TexWidth)));
-  *TexY = TexHeight - (round(((1 - ((std::tan(yangle * PI / 180.0) * 100) / 
-  (700 / AspectRatio))) * TexHeight)) - (TexHeight / 2));
+  double texx = 0, texy = 0;
+  TexelFromCrosshair(&texx, &texy);
+  *TexX = std::min((int)texx, std::max((int)TexWidth - 1, 0));
+  *TexY = std::min((int)texy, std::max((int)TexHeight - 1, 0));
 }
 
 void timer(int i) {
+  FrameTimer::PhaseBegin(FrameTimer::PHASE_UPDATE);
   string str = CrossProcess::EnvironmentGetVariable("WINDOWID");
   if (str.empty()) str = "0";
   if (windowId == "-1") {
@@ -633,11 +1517,27 @@ void timer(int i) {
     std::cout << "Window ID: " << windowId << std::endl;
     #endif
   }
-  if (CrossProcess::WindowIdExists((char *)str.c_str()) && str != "0")
-  window_id_set_parent_window_id((char *)windowId.c_str(), (char *)str.c_str());
-  AspectRatio = std::fmin(std::fmax(AspectRatio, 0.1), 6);
-  MaximumVerticalAngle = (std::atan2((700 / AspectRatio) / 2, 100) * 180.0 / PI) - 30;
-  UpdateMouseLook();
+  if (CrossProcess::WindowIdExists((char *)str.c_str()) && str != "0") {
+    window_id_set_parent_window_id((char *)windowId.c_str(), (char *)str.c_str());
+    #if defined(_WIN32)
+    // ProcIdExists() enumerates every process, a watcher is one handle wait
+    if (!parentProcId) {
+      CrossProcess::ProcIdFromWindowId((char *)str.c_str(), &parentProcId);
+      if (parentProcId) {
+        parentWatcher = CrossProcess::ProcessWatcherCreate();
+        if (!CrossProcess::ProcessWatcherAdd(parentWatcher, parentProcId)) exit(0);
+      }
+    }
+    if (parentProcId && CrossProcess::ProcessWatcherWait(parentWatcher, 0) == parentProcId) exit(0);
+    #endif
+  }
+  UpdateViewLimits();
+  string hovered = HotspotUnderCursor();
+  if (hovered != HotspotHovered) {
+    HotspotHovered = hovered;
+    std::cout << "Hotspot Hovered: " << hovered << std::endl;
+  }
+  FrameTimer::PhaseEnd(FrameTimer::PHASE_UPDATE);
   glutPostRedisplay();
   glutTimerFunc(5, timer, 0);
 }
@@ -648,11 +1548,16 @@ void keyboard(unsigned char key, int x, int y) {
     case 27:
       glutDestroyWindow(window);
       std::cout << "Forced Quit..." << std::endl;
+      InputThreadStop();
       #if defined(X_PROTOCOL)
       XCloseDisplay(display);
       #endif
       exit(0);
       break;
+    case 'p':
+    case 'P':
+      ShowHud = !ShowHud;
+      break;
   }
   glutPostRedisplay();
 }
@@ -664,6 +1569,8 @@ void mouse(int button, int state, int x, int y) {
         int TexX, TexY;
         GetTexelUnderCursor(&TexX, &TexY);
         std::cout << "Texel Clicked: " << TexX << "," << TexY << std::endl;
+        string hotspot = HotspotUnderCursor();
+        if (!hotspot.empty()) std::cout << "Hotspot Clicked: " << hotspot << std::endl;
         std::this_thread::sleep_for(std::chrono::milliseconds(500));
         UpdateEnvironmentVariables();
         break;
@@ -672,9 +1579,547 @@ void mouse(int button, int state, int x, int y) {
   glutPostRedisplay();
 }
 
+unsigned SaveImage(const char *fname, const unsigned char *data, unsigned width, unsigned height) {
+  #if defined(_WIN32)
+  wstring u8fname = widen(fname);
+  return libpng_encode32_file(data, width, height, u8fname.c_str());
+  #else
+  return lodepng_encode32_file(fname, data, width, height);
+  #endif
+}
+
+bool StringToSize(string str, unsigned *width, unsigned *height) {
+  vector<string> vec = StringSplit(str, "x");
+  if (vec.size() != 2) return false;
+  *width  = (unsigned)strtoul(vec[0].c_str(), nullptr, 10);
+  *height = (unsigned)strtoul(vec[1].c_str(), nullptr, 10);
+  return (*width && *height);
+}
+
+int ExportUsage() {
+  std::cerr << "usage: panoview --export cubemap  [panorama.png] [output-prefix] [face-size]" << std::endl;
+  std::cerr << "       panoview --export equirect [panorama.png] [output.png] [width]" << std::endl;
+  std::cerr << "       panoview --export views    [panorama.png] [output-prefix] [width]x[height] [xangle],[yangle] ..." << std::endl;
+  return 1;
+}
+
+/* headless batch conversion, no window or gl context is ever created;
+LoadImage() already hands back the flipped layout SoftRender expects */
+int ExportPanorama(int argc, char **argv) {
+  if (argc < 5) return ExportUsage();
+  string mode = argv[2], output = argv[4];
+  unsigned char *data = nullptr;
+  unsigned pngwidth = 0, pngheight = 0;
+  LoadImage(&data, &pngwidth, &pngheight, argv[3]);
+  if (!data) {
+    std::cerr << "Failed to load panorama: " << argv[3] << std::endl;
+    return 1;
+  }
+  SoftRender::TEXTURE texture = { data, pngwidth, pngheight };
+  SoftRender::CAMERA camera; vector<unsigned char> out;
+  unsigned error = 0, written = 0;
+  if (mode == "cubemap") {
+    unsigned size = (argc > 5) ? (unsigned)strtoul(argv[5], nullptr, 10) : pngheight;
+    const char *faces[] = { "front", "right", "back", "left", "top", "bottom" };
+    const double angles[][2] = { { 0, 0 }, { 90, 0 }, { 180, 0 }, { 270, 0 }, { 0, -90 }, { 0, 90 } };
+    out.resize((size_t)size * size * 4);
+    for (int i = 0; size && i < 6; i++) {
+      SoftRender::CameraFromAngles(angles[i][0], angles[i][1], 90, 1, &camera);
+      SoftRender::RenderPanorama(&texture, &camera, out.data(), size, size, 
+      SoftRender::FILTER_BILINEAR, 0);
+      string fname = output + "_" + faces[i] + ".png";
+      if (SaveImage(fname.c_str(), out.data(), size, size)) error++; else written++;
+    }
+  } else if (mode == "equirect") {
+    unsigned width = (argc > 5) ? (unsigned)strtoul(argv[5], nullptr, 10) : pngwidth;
+    unsigned height = width / 2;
+    out.resize((size_t)width * height * 4);
+    if (width && height) {
+      SoftRender::RenderEquirectangular(&texture, out.data(), width, height, 
+      SoftRender::FILTER_BILINEAR, 0);
+      if (SaveImage(output.c_str(), out.data(), width, height)) error++; else written++;
+    }
+  } else if (mode == "views") {
+    unsigned width = 0, height = 0;
+    if (argc < 7 || !StringToSize(argv[5], &width, &height)) {
+      delete[] data;
+      return ExportUsage();
+    }
+    out.resize((size_t)width * height * 4);
+    for (int i = 6; i < argc; i++) {
+      vector<string> angle = StringSplit(argv[i], ",");
+      if (angle.size() != 2) { error++; continue; }
+      // unlike the viewer, which stretches a square frustum, keep the output's aspect
+      SoftRender::CameraFromAngles(strtod(angle[0].c_str(), nullptr), 
+      strtod(angle[1].c_str(), nullptr), 60, (double)width / height, &camera);
+      SoftRender::RenderPanorama(&texture, &camera, out.data(), width, height, 
+      SoftRender::FILTER_BILINEAR, 0);
+      string fname = output + "_" + to_string(i - 6) + ".png";
+      if (SaveImage(fname.c_str(), out.data(), width, height)) error++; else written++;
+    }
+  } else {
+    delete[] data;
+    return ExportUsage();
+  }
+  delete[] data;
+  std::cout << "Images Written: " << written << std::endl;
+  if (error) std::cerr << "Images Failed: " << error << std::endl;
+  return (error || !written) ? 1 : 0;
+}
+
+/* --verify-picking: draws a texture whose texels encode their own
+coordinates through RenderPanoramaGL(), reads the frame back and checks
+every pixel against what TexelFromViewport() picks for it, so the cpu
+inverse can't silently drift from what the gpu draws */
+unsigned VerifyWidth = 1024, VerifyHeight = 256;
+void VerifyPickingDisplay() {
+  int ww = glutGet(GLUT_WINDOW_WIDTH), wh = glutGet(GLUT_WINDOW_HEIGHT);
+  glViewport(0, 0, ww, wh);
+  vector<unsigned char> frame((size_t)ww * wh * 4);
+  const double angles[][2] = { { 0, 0 }, { 45, 8 }, { 137, -8 }, { 270, 11 }, { 359.5, -11 } };
+  long long checked = 0, missed = 0; int worst = 0;
+  UpdateViewLimits();
+  for (int i = 0; i < 5; i++) {
+    xangle = angles[i][0]; yangle = angles[i][1];
+    PanoramaSetVertAngle(0);
+    glClearColor(0, 0, 0, 0);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    RenderPanoramaGL();
+    glFinish();
+    glReadBuffer(GL_BACK);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, ww, wh, GL_RGBA, GL_UNSIGNED_BYTE, frame.data());
+    for (int row = 0; row < wh; row++) {
+      for (int x = 0; x < ww; x++) {
+        const unsigned char *px = &frame[((size_t)row * ww + x) * 4];
+        if (px[3] == 0) continue;
+        // glReadPixels() rows go up from the bottom, uploaded rows do too
+        int gpux = px[0] | (px[1] << 8), gpuy = (int)VerifyHeight - 1 - px[2];
+        double texx, texy;
+        if (!TexelFromViewport(x, wh - 1 - row, ww, wh, &texx, &texy)) continue;
+        int dx = std::abs((int)texx - gpux); dx = std::min(dx, (int)VerifyWidth - dx);
+        int error = std::max(dx, std::abs((int)texy - gpuy));
+        worst = std::max(worst, error); checked++;
+        if (error > 1) missed++;
+      }
+    }
+  }
+  std::cout << "Pixels Checked: " << checked << std::endl;
+  std::cout << "Pixels Off By More Than One Texel: " << missed << std::endl;
+  std::cout << "Worst Error In Texels: " << worst << std::endl;
+  exit((checked && missed * 1000 <= checked) ? 0 : 1);
+}
+
+int VerifyPicking(int argc, char **argv) {
+  if (argc > 2 && (!StringToSize(argv[2], &VerifyWidth, &VerifyHeight) || 
+    VerifyWidth > 65536 || VerifyHeight > 256)) {
+    std::cerr << "usage: panoview --verify-picking [width]x[height]  (width up to 65536, height up to 256)" << std::endl;
+    return 1;
+  }
+  // red and green hold the column, blue the row in upload order
+  vector<unsigned char> pixels((size_t)VerifyWidth * VerifyHeight * 4);
+  for (unsigned y = 0; y < VerifyHeight; y++) {
+    for (unsigned x = 0; x < VerifyWidth; x++) {
+      unsigned char *px = &pixels[((size_t)y * VerifyWidth + x) * 4];
+      px[0] = x & 255; px[1] = x >> 8; px[2] = y; px[3] = 255;
+    }
+  }
+  glutInit(&argc, argv);
+  glutInitDisplayMode(GLUT_DOUBLE);
+  glutInitWindowSize(640, 480);
+  window = glutCreateWindow("");
+  glClearDepth(1);
+  glEnable(GL_DEPTH_TEST);
+  glDepthFunc(GL_LEQUAL);
+  glGenTextures(1, &tex);
+  glBindTexture(GL_TEXTURE_2D, tex);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, VerifyWidth, VerifyHeight, 0, 
+  GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+  TexWidth = VerifyWidth; TexHeight = VerifyHeight;
+  AspectRatio = TexWidth / TexHeight;
+  glutDisplayFunc(VerifyPickingDisplay);
+  glutMainLoop();
+  return 0;
+}
+
+#if defined(FREEGLUT) && (defined(_WIN32) || defined(X_PROTOCOL))
+/* --server: one process hosting any number of views, each a glut window
+reparented into a host window the way WINDOWID does for a single instance.
+Every view renders from one shared gl context and one timer, so views of
+the same file share a single decoded, uploaded texture. Commands arrive
+one per line on stdin, and the server exits when stdin closes:
+
+  open <parent-window-id> <panorama.png> [cursor.png]  prints "view <n> <window-id>"
+  set <n> NAME=VALUE  (PANORAMA_TEXTURE, PANORAMA_POINTER, PANORAMA_XANGLE or PANORAMA_YANGLE)
+  close <n>
+
+Mouse look drives the view clicked last; the others redraw only when
+something about them changes. */
+
+typedef struct {
+  GLuint Texture;
+  double Width;
+  double Height;
+  int References;
+} SHAREDTEXTURE;
+
+std::map<string, SHAREDTEXTURE> SharedTextures;
+
+/* kind is "panorama", cursors are sprites; decodes and uploads on first use only */
+GLuint SharedTextureAcquire(string kind, string fname, double *width, double *height) {
+  string key = kind + ":" + fname;
+  std::map<string, SHAREDTEXTURE>::iterator it = SharedTextures.find(key);
+  if (it == SharedTextures.end()) {
+    SHAREDTEXTURE shared = { 0, 0, 0, 0 };
+    LoadPanorama(fname.c_str());
+    shared.Texture = tex; shared.Width = TexWidth; shared.Height = TexHeight;
+    it = SharedTextures.insert(std::make_pair(key, shared)).first;
+  }
+  it->second.References++;
+  if (width) *width = it->second.Width;
+  if (height) *height = it->second.Height;
+  return it->second.Texture;
+}
+
+void SharedTextureRelease(string kind, string fname) {
+  std::map<string, SHAREDTEXTURE>::iterator it = SharedTextures.find(kind + ":" + fname);
+  if (it == SharedTextures.end() || --it->second.References > 0) return;
+  glDeleteTextures(1, &it->second.Texture);
+  SharedTextures.erase(it);
+}
+
+typedef struct {
+  int Window;
+  wid_t WindowId;
+  string Parent;
+  string Panorama;
+  string Cursor;
+  GLuint PanoramaTexture;
+  int CursorSprite;
+  double Width, Height;
+  int ParentWidth, ParentHeight;
+  double XAngle, YAngle;
+  Camera::STATE Camera;
+  bool Dirty;
+} VIEW;
+
+std::map<int, VIEW> Views;
+int ServerWindow = 0;
+int NextView = 1;
+int ActiveView = 0;
+string ServerInput;
+
+VIEW *ViewFromWindow(int window) {
+  for (std::map<int, VIEW>::iterator it = Views.begin(); it != Views.end(); it++)
+    if (it->second.Window == window) return &it->second;
+  return nullptr;
+}
+
+/* the viewer keeps a single view's state in globals, so a view is swapped
+in around every callback that touches it and swapped back out after */
+void ViewActivate(VIEW *view) {
+  glutSetWindow(view->Window);
+  windowId = view->WindowId;
+  tex = view->PanoramaTexture; cur = view->CursorSprite;
+  TexWidth = view->Width; TexHeight = view->Height;
+  AspectRatio = (TexHeight > 0) ? TexWidth / TexHeight : 1;
+  UpdateViewLimits();
+  xangle = view->XAngle; yangle = view->YAngle;
+  ViewCamera = view->Camera;
+  MouseLookActive = (ActiveView && &Views[ActiveView] == view);
+}
+
+void ViewDeactivate(VIEW *view) {
+  view->XAngle = xangle; view->YAngle = yangle;
+  view->Camera = ViewCamera;
+}
+
+void SpritesInUse(vector<bool> *inuse) {
+  int sprites[2] = { cur, MarkerSprite };
+  for (int i = 0; i < 2; i++)
+    if (sprites[i] >= 0 && sprites[i] < (int)inuse->size()) (*inuse)[sprites[i]] = true;
+  for (std::map<int, VIEW>::iterator it = Views.begin(); it != Views.end(); it++) {
+    int sprite = it->second.CursorSprite;
+    if (sprite >= 0 && sprite < (int)inuse->size()) (*inuse)[sprite] = true;
+  }
+}
+
+void ServerDisplay() {
+  VIEW *view = ViewFromWindow(glutGetWindow());
+  if (!view) return;
+  ViewActivate(view);
+  DisplayGraphics();
+  ViewDeactivate(view);
+  view->Dirty = false;
+}
+
+void ServerMouse(int button, int state, int x, int y) {
+  VIEW *view = ViewFromWindow(glutGetWindow());
+  if (!view || button != GLUT_LEFT_BUTTON || state != GLUT_DOWN) return;
+  for (std::map<int, VIEW>::iterator it = Views.begin(); it != Views.end(); it++) {
+    if (&it->second != view) continue;
+    if (ActiveView != it->first) {
+      // motion sampled for the previous view shouldn't carry over
+      InputQueue::EVENT event; while (InputQueue::Pop(&event)) { }
+      if (ActiveView && Views.count(ActiveView)) Views[ActiveView].Dirty = true;
+      ActiveView = it->first;
+      DisplayCursor(false);
+      InputThreadStart();
+    }
+    ViewActivate(view);
+    int TexX, TexY;
+    GetTexelUnderCursor(&TexX, &TexY);
+    ViewDeactivate(view);
+    std::cout << "view " << it->first << " texel " << TexX << "," << TexY << std::endl;
+  }
+}
+
+void ServerKeyboard(unsigned char key, int x, int y) {
+  if (key == 'p' || key == 'P') {
+    ShowHud = !ShowHud;
+    for (std::map<int, VIEW>::iterator it = Views.begin(); it != Views.end(); it++)
+      it->second.Dirty = true;
+  }
+}
+
+/* view windows are never destroyed: with GLUT_USE_CURRENT_CONTEXT they own
+the shared context as much as the server window does; a closed view's
+window is detached from its host, hidden and reused by the next open */
+vector<int> FreeWindows;
+
+void ServerClose(int n, bool hostAlive) {
+  if (!Views.count(n)) return;
+  VIEW *view = &Views[n];
+  SharedTextureRelease("panorama", view->Panorama);
+  // a host window that is gone took our window down with it
+  if (hostAlive) {
+    #if defined(_WIN32)
+    SetParent((HWND)(void *)strtoull(view->WindowId.c_str(), nullptr, 10), nullptr);
+    #else
+    Window child = strtoull(view->WindowId.c_str(), nullptr, 10);
+    XReparentWindow(display, child, XDefaultRootWindow(display), 0, 0);
+    XFlush(display);
+    #endif
+    glutSetWindow(view->Window);
+    glutHideWindow();
+    FreeWindows.push_back(view->Window);
+  }
+  Views.erase(n);
+  if (ActiveView == n) ActiveView = 0;
+}
+
+#if defined(X_PROTOCOL)
+/* xlib's default handler exits, but a host can destroy a view's window
+whenever it likes, so errors about dead windows are expected here */
+int ServerXError(Display *display, XErrorEvent *error) {
+  std::cerr << "X error " << (int)error->error_code << " on resource " << error->resourceid << std::endl;
+  return 0;
+}
+#endif
+
+void ServerOpen(string parent, string panorama, string cursor) {
+  if (!CrossProcess::WindowIdExists((char *)parent.c_str())) {
+    std::cout << "error no such window " << parent << std::endl;
+    return;
+  }
+  VIEW view;
+  view.Parent = parent; view.Panorama = panorama; view.Cursor = cursor;
+  glutSetWindow(ServerWindow);
+  view.PanoramaTexture = SharedTextureAcquire("panorama", panorama, &view.Width, &view.Height);
+  view.CursorSprite = LoadSprite(cursor.c_str());
+  if (!FreeWindows.empty()) {
+    view.Window = FreeWindows.back(); FreeWindows.pop_back();
+    glutSetWindow(view.Window);
+    glutShowWindow();
+  } else {
+    // every view draws with the hidden server window's context
+    glutSetOption(GLUT_RENDERING_CONTEXT, GLUT_USE_CURRENT_CONTEXT);
+    view.Window = glutCreateWindow("");
+    glutDisplayFunc(ServerDisplay);
+    glutMouseFunc(ServerMouse);
+    glutKeyboardFunc(ServerKeyboard);
+  }
+  #if defined(_WIN32)
+  view.WindowId = std::to_string((unsigned long long)(void *)WindowFromDC(wglGetCurrentDC()));
+  #else
+  view.WindowId = std::to_string((unsigned long)glXGetCurrentDrawable());
+  #endif
+  window_id_set_parent_window_id((char *)view.WindowId.c_str(), (char *)parent.c_str());
+  window_get_size_from_id((char *)parent.c_str(), &view.ParentWidth, &view.ParentHeight);
+  view.XAngle = 0; view.YAngle = 0;
+  TexWidth = view.Width; TexHeight = view.Height;
+  AspectRatio = (TexHeight > 0) ? TexWidth / TexHeight : 1;
+  xangle = 0; yangle = 0;
+  InitialViewFromSettings(0, 0);
+  view.Camera = ViewCamera;
+  view.Dirty = true;
+  int n = NextView++;
+  Views[n] = view;
+  std::cout << "view " << n << " " << view.WindowId << std::endl;
+}
+
+void ServerSet(int n, string name, string value) {
+  if (!Views.count(n)) return;
+  VIEW *view = &Views[n];
+  glutSetWindow(ServerWindow);
+  if (name == "PANORAMA_TEXTURE") {
+    GLuint texture = SharedTextureAcquire("panorama", value, &view->Width, &view->Height);
+    SharedTextureRelease("panorama", view->Panorama);
+    view->Panorama = value; view->PanoramaTexture = texture;
+  } else if (name == "PANORAMA_POINTER") {
+    int sprite = LoadSprite(value.c_str());
+    if (sprite >= 0) { view->Cursor = value; view->CursorSprite = sprite; }
+  } else if (name == "PANORAMA_XANGLE" || name == "PANORAMA_YANGLE") {
+    ViewActivate(view);
+    if (name == "PANORAMA_XANGLE") xangle = strtod(value.c_str(), nullptr);
+    else yangle = strtod(value.c_str(), nullptr);
+    InitialViewFromSettings(xangle, yangle);
+    ViewDeactivate(view);
+  }
+  view->Dirty = true;
+}
+
+void ServerCommand(string line) {
+  vector<string> args = StringSplit(line, " ");
+  if (args.empty()) return;
+  if (args[0] == "open" && args.size() >= 3) {
+    ServerOpen(args[1], args[2], (args.size() > 3) ? args[3] : cwd + "/cursor.png");
+  } else if (args[0] == "set" && args.size() >= 3) {
+    vector<string> equalssplit = StringSplitByFirstEqualsSign(line.substr(line.find(args[2])));
+    if (equalssplit.size() == 2) ServerSet(atoi(args[1].c_str()), equalssplit[0], equalssplit[1]);
+  } else if (args[0] == "close" && args.size() >= 2) {
+    ServerClose(atoi(args[1].c_str()), true);
+  }
+}
+
+/* reads whatever stdin has without blocking, returns false once it closed */
+bool ServerReadInput() {
+  #if defined(_WIN32)
+  DWORD bytesAvail = 0, bytesRead = 0;
+  HANDLE hPipe = GetStdHandle(STD_INPUT_HANDLE);
+  if (!PeekNamedPipe(hPipe, nullptr, 0, nullptr, &bytesAvail, nullptr)) return false;
+  if (!bytesAvail) return true;
+  string buffer; buffer.resize(bytesAvail, '\0');
+  if (!ReadFile(hPipe, &buffer[0], bytesAvail, &bytesRead, nullptr)) return false;
+  ServerInput.append(buffer, 0, bytesRead);
+  #else
+  char buffer[BUFSIZ]; ssize_t nRead = 0;
+  while ((nRead = read(STDIN_FILENO, buffer, BUFSIZ)) > 0)
+    ServerInput.append(buffer, nRead);
+  if (nRead == 0) return false;
+  #endif
+  return true;
+}
+
+int ServerTicks = 0;
+void ServerTimer(int i) {
+  bool open = ServerReadInput();
+  size_t pos = 0;
+  while ((pos = ServerInput.find('\n')) != string::npos) {
+    string line = ServerInput.substr(0, pos);
+    ServerInput.erase(0, pos + 1);
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    ServerCommand(line);
+  }
+  if (!open) {
+    InputThreadStop();
+    #if defined(X_PROTOCOL)
+    XCloseDisplay(display);
+    #endif
+    exit(0);
+  }
+  // host windows are checked a few times a second rather than every tick
+  if (++ServerTicks % 50 == 0) {
+    vector<int> gone;
+    for (std::map<int, VIEW>::iterator it = Views.begin(); it != Views.end(); it++) {
+      VIEW *view = &it->second;
+      if (!CrossProcess::WindowIdExists((char *)view->Parent.c_str())) {
+        gone.push_back(it->first); continue;
+      }
+      int width = 0, height = 0;
+      window_get_size_from_id((char *)view->Parent.c_str(), &width, &height);
+      if (width != view->ParentWidth || height != view->ParentHeight) {
+        window_id_set_parent_window_id((char *)view->WindowId.c_str(), (char *)view->Parent.c_str());
+        view->ParentWidth = width; view->ParentHeight = height; view->Dirty = true;
+      }
+    }
+    for (size_t j = 0; j < gone.size(); j++) ServerClose(gone[j], false);
+  }
+  for (std::map<int, VIEW>::iterator it = Views.begin(); it != Views.end(); it++) {
+    if (it->first == ActiveView || it->second.Dirty) 
+      glutPostWindowRedisplay(it->second.Window);
+  }
+  glutTimerFunc(5, ServerTimer, 0);
+}
+
+int ServePanoramas(int argc, char **argv) {
+  CrossProcess::PROCID pid; char *exe = nullptr;
+  CrossProcess::ProcIdFromSelf(&pid);
+  CrossProcess::ExeFromProcId(pid, &exe);
+  string exefile = exe ? exe : "";
+  if (exefile.find_last_of("/\\") != string::npos)
+  cwd = exefile.substr(0, exefile.find_last_of("/\\"));
+  #if !defined(_WIN32)
+  int flags = fcntl(STDIN_FILENO, F_GETFL, 0);
+  if (flags != -1) fcntl(STDIN_FILENO, F_SETFL, flags | O_NONBLOCK);
+  #endif
+  #if defined(X_PROTOCOL)
+  display = XOpenDisplay(nullptr);
+  XSetErrorHandler(ServerXError);
+  #endif
+  // the server renders on the gpu only, views share textures through the context
+  SoftwareRendering = false;
+  SharedPanoramas = (strcmp(CrossProcess::EnvironmentGetVariable("PANORAMA_CACHE"), "0") != 0);
+  atexit(ReleasePanoramaPixels);
+  glutInit(&argc, argv);
+  glutInitDisplayMode(GLUT_DOUBLE);
+  glutInitWindowSize(640, 480);
+  ServerWindow = glutCreateWindow("panoview server");
+  glutHideWindow();
+  glClearColor(0, 0, 0, 1);
+  glClearDepth(1);
+  glEnable(GL_DEPTH_TEST);
+  glDepthFunc(GL_LEQUAL);
+  glShadeModel(GL_SMOOTH);
+  glHint(GL_PERSPECTIVE_CORRECTION_HINT, GL_NICEST);
+  ShowHud = (strcmp(CrossProcess::EnvironmentGetVariable("PANORAMA_HUD"), "1") == 0);
+  GpuTimerInit();
+  #if defined(X_PROTOCOL)
+  RawMotion = RawMotionInit();
+  #endif
+  atexit(InputThreadStop);
+  glutTimerFunc(0, ServerTimer, 0);
+  glutMainLoop();
+  return 0;
+}
+#endif
+
 } // anonymous namespace
 
+#if !defined(PANOVIEW_BENCHMARK)
 int main(int argc, char **argv) {
+  #if defined(X_PROTOCOL)
+  // mouse look samples the pointer on its own thread through display
+  XInitThreads();
+  #endif
+  Tracer::Start(CrossProcess::EnvironmentGetVariable("PANORAMA_TRACE"));
+  double startupBegin = Tracer::Now();
+  if (argc > 1 && strcmp(argv[1], "--export") == 0)
+    return ExportPanorama(argc, argv);
+  if (argc > 1 && strcmp(argv[1], "--verify-picking") == 0)
+    return VerifyPicking(argc, argv);
+  if (argc > 1 && strcmp(argv[1], "--server") == 0) {
+    #if defined(FREEGLUT) && (defined(_WIN32) || defined(X_PROTOCOL))
+    return ServePanoramas(argc, argv);
+    #else
+    std::cerr << "--server needs freeglut on Windows or X11" << std::endl;
+    return 1;
+    #endif
+  }
   #if defined(__APPLE__) && defined(__MACH__)
   glutInit(&argc, argv);
   glutInitDisplayMode(GLUT_DOUBLE);
@@ -735,8 +2180,16 @@ int main(int argc, char **argv) {
   glDepthFunc(GL_LEQUAL);
   glShadeModel(GL_SMOOTH);
   glHint(GL_PERSPECTIVE_CORRECTION_HINT, GL_NICEST);
+  ShowHud = (strcmp(CrossProcess::EnvironmentGetVariable("PANORAMA_HUD"), "1") == 0);
+  GpuTimerInit();
+  SoftwareRendering = (strcmp(CrossProcess::EnvironmentGetVariable("PANORAMA_RENDERER"), "software") == 0);
+  SharedPanoramas = (strcmp(CrossProcess::EnvironmentGetVariable("PANORAMA_CACHE"), "0") != 0);
+  atexit(ReleasePanoramaPixels);
   LoadPanorama(panorama.c_str());
   LoadCursor(cursor.c_str());
+  LoadHotspots(CrossProcess::EnvironmentGetVariable("PANORAMA_HOTSPOTS"));
+  LoadMarkers(CrossProcess::EnvironmentGetVariable("PANORAMA_MARKERS"),
+  CrossProcess::EnvironmentGetVariable("PANORAMA_MARKER_ATLAS"));
   glutKeyboardFunc(keyboard);
   glutMouseFunc(mouse);
   glutTimerFunc(0, timer, 0);
@@ -744,20 +2197,26 @@ int main(int argc, char **argv) {
   string str2 = CrossProcess::EnvironmentGetVariable("PANORAMA_YANGLE");
   double initxangle = strtod((!str1.empty()) ? str1.c_str() : "0", nullptr); 
   double inityangle = strtod((!str2.empty()) ? str2.c_str() : "0", nullptr);
-  for (size_t i = 0; i < 150; i++) {
-    UpdateMouseLook();
-    xangle = initxangle;
-    yangle = inityangle;
-    std::this_thread::sleep_for(std::chrono::milliseconds(5));
-  }
+  string str3 = CrossProcess::EnvironmentGetVariable("PANORAMA_DAMPING");
+  if (!str3.empty()) CameraDamping = std::fmax(strtod(str3.c_str(), nullptr), 0);
+  InitialViewFromSettings(initxangle, inityangle);
+  PointerCenterInit();
+  #if defined(X_PROTOCOL)
+  RawMotion = RawMotionInit();
+  #endif
+  InputThreadStart();
+  atexit(InputThreadStop);
+  Tracer::Complete("startup", startupBegin, Tracer::Now());
   glutShowWindow();
   #if defined(_WIN32)
   ShowWindow((HWND)(void *)strtoull(windowId.c_str(), nullptr, 10), SW_SHOW);
   #endif
   DisplayCursor(false);
   glutMainLoop();
+  InputThreadStop();
   #if defined(X_PROTOCOL)
   XCloseDisplay(display);
   #endif
   return 0;
 }
+#endif
@@ -58,7 +58,7 @@
 #include <sys/proc_info.h>
 #include <libproc.h>
 #elif defined(__linux__) && !defined(__ANDROID__)
-#include <proc/readproc.h>
+#include <dirent.h>
 #elif defined(__FreeBSD__)
 #include <sys/user.h>
 #include <libutil.h>
@@ -345,14 +345,22 @@ static std::vector<pid_t> PidFromPpid(pid_t parentProcId) {
     }
   }
   #elif defined(__linux__) && !defined(__ANDROID__)
-  PROCTAB *proc = openproc(PROC_FILLSTAT);
-  while (proc_t *proc_info = readproc(proc, nullptr)) {
-    if (proc_info->ppid == parentProcId) {
-      vec.push_back(proc_info->tgid);
+  if (DIR *proc = opendir("/proc")) {
+    while (dirent *entry = readdir(proc)) {
+      char *end = nullptr; long pid = strtol(entry->d_name, &end, 10);
+      if (pid <= 0 || *end) continue;
+      // the command may hold spaces and parentheses, the ppid follows the last ')'
+      FILE *file = fopen(("/proc/" + to_string(pid) + "/stat").c_str(), "r");
+      if (!file) continue;
+      char buffer[1024]; size_t nread = fread(buffer, 1, sizeof(buffer) - 1, file);
+      fclose(file); buffer[nread] = '\0';
+      char *paren = strrchr(buffer, ')'); char state = 0; int ppid = 0;
+      if (paren && sscanf(paren + 1, " %c %d", &state, &ppid) == 2 && ppid == parentProcId) {
+        vec.push_back((pid_t)pid);
+      }
     }
-    freeproc(proc_info);
+    closedir(proc);
   }
-  closeproc(proc);
   #elif defined(__FreeBSD__)
   int cntp; if (kinfo_proc *proc_info = kinfo_getallproc(&cntp)) {
     for (int i = 0; i < cntp; i++) {